@@ -8,6 +8,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <omp.h>
 #include "refactor_arguments.h"
 
 // INCLUDE GUARD
@@ -40,6 +41,26 @@ int absentDataExtrapolate;
 int input_individuals_count_allocation = -1;
 int num_loci_allocation = -1;
 int *motif_lengths = NULL;
+int threads;
+unsigned long long random_seed;
+int packed_snps;
+int streaming;
+int multinomial;
+int samples_per_population;
+int checkpoints;
+int design;
+double reject_radius;
+double reject_target[REJECT_TARGET_STATISTICS];
+double time_budget;
+double time_budget_start;
+int schedule_length;
+int estimate_cost;
+int replay_iteration;
+int shard_first;
+int shard_total;
+
+// Copy of the configuration for the kernels
+struct run_config run_config;
 
 // Stored arrays from the command line
 int *bottleneck_individuals_count_random_choices = NULL;
@@ -72,6 +93,15 @@ void reportError(char *message){
   exit(1);
 }
 
+/*! \brief Prints a note about how the run is carried out, without stopping it.
+ */
+void reportNote(char *message){
+  fprintf(stderr, "ONESAMP NOTE\n");
+  fprintf(stderr, message, parseProgramName());
+  fprintf(stderr, "\n");
+  fflush(stderr);
+}
+
 /*! \brief Exits the program when an error with the arguments is encountered.
  */
 void reportArgumentError(char *message){
@@ -109,7 +139,23 @@ void resetArguments(){
   example = FALSE;
   raw_stats = FALSE;
   single_generation = FALSE;
+  example_pop = FALSE;
   absentDataExtrapolate = FALSE;
+  threads = -1;
+  random_seed = 0;
+  packed_snps = FALSE;
+  streaming = FALSE;
+  multinomial = FALSE;
+  samples_per_population = -1;
+  checkpoints = FALSE;
+  design = -1;
+  reject_radius = -1;
+  time_budget = -1;
+  schedule_length = 0;
+  estimate_cost = FALSE;
+  replay_iteration = -1;
+  shard_first = -1;
+  shard_total = -1;
   // Program Name
   if(programName != NULL) free(programName);
   programName = NULL;
@@ -134,38 +180,130 @@ void resetArguments(){
   if(theta_random_choices != NULL) free(theta_random_choices);
   theta_random_choices = NULL;
   if(motif_lengths != NULL) free(motif_lengths);
+  motif_lengths = NULL;
+}
+
+/*! \brief Returns how many iterations have their parameters drawn.
+ *
+ * All of them, unless a time budget is set: then the schedule starts with at
+ * most SCHEDULE_BLOCK_ITERATIONS and is extended by
+ * extendParameterSchedule() as iterations are simulated.
+ */
+int parseScheduleLength(){
+  if(schedule_length == 0){
+    schedule_length = parseIterations();
+    if(parseTimeBudget() >= 0 && schedule_length > SCHEDULE_BLOCK_ITERATIONS) schedule_length = SCHEDULE_BLOCK_ITERATIONS;
+  }
+  return schedule_length;
+}
+
+/*! \brief Draws the parameters of iterations up to length - 1, if not drawn yet.
+ *
+ * Only parameters that are drawn at all (see parseArguments()) are extended.
+ * Must not be called while other threads read parameters.
+ */
+void extendParameterSchedule(int length){
+  int first = parseScheduleLength();
+  if(length <= first) return;
+  bottleneck_individuals_count_random_choices = (int *)realloc(bottleneck_individuals_count_random_choices, length * sizeof(int));
+  drawStruct7(bottleneck_individuals_count_random_choices, first, length);
+  if(bottleneck_length_random_choices != NULL){
+    bottleneck_length_random_choices = (int *)realloc(bottleneck_length_random_choices, length * sizeof(int));
+    drawStruct8(bottleneck_length_random_choices, first, length);
+  }
+  if(theta_random_choices != NULL){
+    theta_random_choices = (double *)realloc(theta_random_choices, length * sizeof(double));
+    drawStruct9(theta_random_choices, first, length);
+  }
+  if(mutation_rate_random_choices != NULL){
+    mutation_rate_random_choices = (double *)realloc(mutation_rate_random_choices, length * sizeof(double));
+    drawStruct10(mutation_rate_random_choices, first, length);
+  }
+  schedule_length = length;
 }
 
 /*! \brief Allocates memory for simulated bottlenecks.
  */
 void allocateStruct7(int **bottleneck_individuals_count_random_choices_ptr){
+  *bottleneck_individuals_count_random_choices_ptr = (int *)malloc(parseScheduleLength() * sizeof(int *));
+  drawStruct7(*bottleneck_individuals_count_random_choices_ptr, 0, parseScheduleLength());
+}
+
+/*! \brief Draws the bottleneck sizes of iterations first to last - 1.
+ */
+void drawStruct7(int *choices, int first, int last){
   int j;
-  *bottleneck_individuals_count_random_choices_ptr = (int *)malloc(parseIterations() * sizeof(int *));
-  for(j = 0; j < parseIterations(); j++) (*bottleneck_individuals_count_random_choices_ptr)[j] = randomQuantizedIntervalSelection(parseBottleneckMin(), parseBottleneckMax(), 1);
+  for(j = first; j < last; j++){
+    if(parseDesign() != DESIGN_RANDOM){
+      choices[j] = quantizedIntervalPoint(parseBottleneckMin(), parseBottleneckMax(), 1, designPoint(parseDesign(), parseRandomSeed(), parseFirstIteration() + j, parseDesignPoints(), DESIGN_AXIS_BOTTLENECK));
+      continue;
+    }
+    useRandomStream(j, RANDOM_SUBSTREAM_BOTTLENECK);
+    choices[j] = randomQuantizedIntervalSelection(parseBottleneckMin(), parseBottleneckMax(), 1);
+  }
 }
 
 /*! \brief Allocates memory for simulated bottleneck lengths.
  */
 void allocateStruct8(int **bottleneck_length_random_choices_ptr){
+  *bottleneck_length_random_choices_ptr = (int *)malloc(parseScheduleLength() * sizeof(int *));
+  drawStruct8(*bottleneck_length_random_choices_ptr, 0, parseScheduleLength());
+}
+
+/*! \brief Draws the bottleneck lengths of iterations first to last - 1.
+ */
+void drawStruct8(int *choices, int first, int last){
   int j;
-  *bottleneck_length_random_choices_ptr = (int *)malloc(parseIterations() * sizeof(int *));
-  for(j = 0; j < parseIterations(); j++) (*bottleneck_length_random_choices_ptr)[j] = randomQuantizedIntervalSelection(parseBottleneckLengthMin(), parseBottleneckLengthMax(), 1);
+  for(j = first; j < last; j++){
+    if(parseDesign() != DESIGN_RANDOM){
+      choices[j] = quantizedIntervalPoint(parseBottleneckLengthMin(), parseBottleneckLengthMax(), 1, designPoint(parseDesign(), parseRandomSeed(), parseFirstIteration() + j, parseDesignPoints(), DESIGN_AXIS_DURATION));
+      continue;
+    }
+    useRandomStream(j, RANDOM_SUBSTREAM_DURATION);
+    choices[j] = randomQuantizedIntervalSelection(parseBottleneckLengthMin(), parseBottleneckLengthMax(), 1);
+  }
 }
 
 /*! \brief Allocates memory for simulated theta values.
  */
 void allocateStruct9(double **theta_random_choices_ptr){
+  *theta_random_choices_ptr = (double *)malloc(parseScheduleLength() * sizeof(double *));
+  drawStruct9(*theta_random_choices_ptr, 0, parseScheduleLength());
+}
+
+/*! \brief Draws the values of theta of iterations first to last - 1.
+ */
+void drawStruct9(double *choices, int first, int last){
   int j;
-  *theta_random_choices_ptr = (double *)malloc(parseIterations() * sizeof(double *));
-  for(j = 0; j < parseIterations(); j++) (*theta_random_choices_ptr)[j] = randomQuantizedIntervalSelection(parseThetaMin(), parseThetaMax(), 0.00000001);
+  for(j = first; j < last; j++){
+    if(parseDesign() != DESIGN_RANDOM){
+      choices[j] = quantizedIntervalPoint(parseThetaMin(), parseThetaMax(), 0.00000001, designPoint(parseDesign(), parseRandomSeed(), parseFirstIteration() + j, parseDesignPoints(), DESIGN_AXIS_THETA));
+      continue;
+    }
+    useRandomStream(j, RANDOM_SUBSTREAM_THETA);
+    choices[j] = randomQuantizedIntervalSelection(parseThetaMin(), parseThetaMax(), 0.00000001);
+  }
 }
 
 /*! \brief Allocates memory for simulated mutation rates.
  */
 void allocateStruct10(double **mutation_rate_random_choices_ptr){
+  *mutation_rate_random_choices_ptr = (double *)malloc(parseScheduleLength() * sizeof(double *));
+  drawStruct10(*mutation_rate_random_choices_ptr, 0, parseScheduleLength());
+}
+
+/*! \brief Draws the mutation rates of iterations first to last - 1.
+ */
+void drawStruct10(double *choices, int first, int last){
   int j;
-  *mutation_rate_random_choices_ptr = (double *)malloc(parseIterations() * sizeof(double *));
-  for(j = 0; j < parseIterations(); j++) (*mutation_rate_random_choices_ptr)[j] = randomQuantizedIntervalSelection(parseMRateMin(), parseMRateMax(), 0.00000001);
+  for(j = first; j < last; j++){
+    if(parseDesign() != DESIGN_RANDOM){
+      choices[j] = quantizedIntervalPoint(parseMRateMin(), parseMRateMax(), 0.00000001, designPoint(parseDesign(), parseRandomSeed(), parseFirstIteration() + j, parseDesignPoints(), DESIGN_AXIS_MUTATION));
+      continue;
+    }
+    useRandomStream(j, RANDOM_SUBSTREAM_MUTATION);
+    choices[j] = randomQuantizedIntervalSelection(parseMRateMin(), parseMRateMax(), 0.00000001);
+  }
 }
 
 /*! \brief Returns the name of the executable.
@@ -204,6 +342,7 @@ int parseFormFlag(){
 /*! \brief Returns the number of trials of bottleneck generations to simulate.
  */
 int parseIterations(){
+  if(repetitions == -1 && time_budget >= 0) return INT_MAX;  // Until the budget is spent
   if(repetitions <= 0) reportArgumentError((char *) "%s: argument -t, number of repetitions, must be a positive integer.");
   return repetitions;
 }
@@ -219,6 +358,7 @@ int parseNLoci(){
  */
 void setNLoci(int size){
   num_loci = size;
+  run_config.num_loci = size;
 }
 
 /*! \brief Returns the size of the input samples.
@@ -239,6 +379,7 @@ int parseInputSamples(){
 void setInputSamples(int size){
   input_individuals_count = size;
   final_individuals_count = size;
+  run_config.input_samples = size;
 }
 
 /*! \brief Returns the size of the input samples.
@@ -339,13 +480,149 @@ double parseMRateMax(){
   return mutation_rate[1];
 }
 
+/*! \brief Returns the number of threads that simulate iterations concurrently.
+ *
+ * With fewer iterations than threads, the threads left over share the loci of
+ * each iteration instead.
+ */
+int parseThreads(){
+  if(threads == -1) return 1;
+  if(threads <= 0) reportArgumentError((char *) "%s: argument -j, number of threads, must be a positive integer (or -j alone to use every core)");
+  return threads;
+}
+
 /*! \brief Specifies whether the program is to use random numbers from the GFSR algorithm or C's library.
  */
 int parseRFlag(){
-  if(randomFlag == -1) reportArgumentError((char *) "%s: argument -r, flag to determine source of random numbers, must be -rGFSR (for GFSR values), -rRESET (for GFSR values with a reset of the GFSR register), or -rC (for values from C's random number generator)");
+  if(randomFlag == -1) reportArgumentError((char *) "%s: argument -r, flag to determine source of random numbers, must be -rGFSR (for GFSR values), -rRESET (for GFSR values with a reset of the GFSR register), -rC (for values from C's random number generator), or -rPHILOX[seed] (for reproducible counter-based streams, one per iteration)");
   return randomFlag;
 }
 
+/*! \brief Returns true if SNP generations are simulated as packed bit-planes.
+ */
+int parsePackedSNPs(){
+  if(packed_snps && parseFormFlag()) reportArgumentError((char *) "%s: argument -k, packed simulation of SNPs, cannot be used with microsatellites (-m)");
+  return packed_snps;
+}
+
+/*! \brief Returns true if each iteration is summarized and printed as soon as it is simulated.
+ */
+int parseStreaming(){
+  return streaming || time_budget >= 0;
+}
+
+/*! \brief Returns the wall-clock time in seconds after which no iteration is started (--time-budget), or -1 for none.
+ */
+double parseTimeBudget(){
+  return time_budget;
+}
+
+/*! \brief Returns true once the time budget, counted from when the arguments were parsed, is spent.
+ */
+int timeBudgetSpent(){
+  return time_budget >= 0 && omp_get_wtime() - time_budget_start >= time_budget;
+}
+
+/*! \brief Returns true if the cost of the run is estimated from a few of its iterations instead of running it (--estimate-cost).
+ */
+int parseEstimateCost(){
+  if(!estimate_cost) return FALSE;
+  if(raw_stats) reportArgumentError((char *) "%s: argument --estimate-cost, estimate of the cost of the simulations, has nothing to estimate with -w");
+  if(repetitions == -1 && time_budget >= 0) reportArgumentError((char *) "%s: argument --estimate-cost, estimate of the cost of the simulations, needs -t when a time budget is set");
+  return TRUE;
+}
+
+/*! \brief Returns the iteration regenerated and dumped alone (--replay-iteration), or -1 to run every iteration.
+ */
+int parseReplayIteration(){
+  if(replay_iteration == -1) return -1;
+  if(raw_stats) reportArgumentError((char *) "%s: argument --replay-iteration, regeneration of one iteration, has no iteration to regenerate with -w");
+  if(!STREAM_RANDOM_FLAG) reportArgumentError((char *) "%s: argument --replay-iteration, regeneration of one iteration, needs the counter-based streams of -rPHILOX[seed], with the seed of the run replayed");
+  if(replay_iteration >= parseIterations()) reportArgumentError((char *) "%s: argument --replay-iteration, regeneration of one iteration, must be below the number of iterations (-t)");
+  if(estimate_cost || reject_radius != -1) reportArgumentError((char *) "%s: argument --replay-iteration, regeneration of one iteration, cannot be combined with --estimate-cost or --reject");
+  return replay_iteration;
+}
+
+/*! \brief Returns the number of final samples drawn from each simulated population.
+ */
+int parseSamplesPerPopulation(){
+  if(samples_per_population == -1) return 1;
+  if(samples_per_population <= 0) reportArgumentError((char *) "%s: argument -n, number of final samples per simulated population, must be a positive integer");
+  return samples_per_population;
+}
+
+/*! \brief Copies the validated configuration read by the kernels into run_config.
+ */
+void snapshotRunConfig(){
+  run_config.form_flag = parseFormFlag();
+  run_config.num_loci = parseNLoci();
+  run_config.input_samples = parseInputSamples();
+}
+
+/*! \brief Returns true if each simulated population is sampled after every duration in the range of -d.
+ */
+int parseCheckpoints(){
+  if(checkpoints && multinomial) reportArgumentError((char *) "%s: argument -c, samples at every bottleneck duration, cannot be combined with -q");
+  return checkpoints;
+}
+
+/*! \brief Returns the design of the per-iteration parameter schedule (DESIGN_RANDOM by default).
+ */
+int parseDesign(){
+  if(design == DESIGN_LATIN_HYPERCUBE && parseIterations() == INT_MAX) reportArgumentError((char *) "%s: argument -yLHS, Latin hypercube schedule, has one stratum per iteration and needs -t when a time budget is set");
+  if(design == -1) return DESIGN_RANDOM;
+  if(design != DESIGN_RANDOM && !STREAM_RANDOM_FLAG) reportArgumentError((char *) "%s: argument -y, low-discrepancy schedule, is scrambled by the seed of -rPHILOX[seed] and needs it");
+  return design;
+}
+
+/*! \brief Returns the number of the first iteration of this run among those of a sharded run (--shard), or 0.
+ *
+ * Iteration i of the run draws its parameters and its random streams as
+ * iteration parseFirstIteration() + i, so shards of one seed take disjoint
+ * parts of a single run.
+ */
+int parseFirstIteration(){
+  if(shard_first == -1) return 0;
+  if(!STREAM_RANDOM_FLAG) reportArgumentError((char *) "%s: argument --shard, part of a sharded run, needs the counter-based streams of -rPHILOX[seed], with the seed of the whole run");
+  if(time_budget >= 0) reportArgumentError((char *) "%s: argument --shard, part of a sharded run, cannot be combined with --time-budget");
+  if(shard_first + (long long) parseIterations() > shard_total) reportArgumentError((char *) "%s: argument --shard=first,total, part of a sharded run, must leave room for the -t iterations of the shard after first");
+  return shard_first;
+}
+
+/*! \brief Returns the number of points of the parameter design: the iterations of the whole run (--shard), or of this one.
+ */
+int parseDesignPoints(){
+  if(shard_total == -1) return parseIterations();
+  return shard_total;
+}
+
+/*! \brief Returns the largest normalised distance of the statistics known before LD at which samples are kept (--reject), or -1 to keep all.
+ */
+double parseRejectRadius(){
+  if(reject_radius == -1) return -1;
+  if(parseStreaming()) reportArgumentError((char *) "%s: argument --reject, early rejection of distant samples, needs every sample before it can normalise statistics and cannot be combined with -z or --time-budget");
+  if(example_pop || raw_stats) reportArgumentError((char *) "%s: argument --reject, early rejection of distant samples, only applies to the statistics of simulated samples (-e)");
+  return reject_radius;
+}
+
+/*! \brief Returns the observed statistics given to --reject, in the order of a row printed by -w.
+ */
+const double *parseRejectTarget(){
+  return reject_target;
+}
+
+/*! \brief Returns true if bottleneck generations are approximated by drifting allele counts.
+ */
+int parseMultinomial(){
+  return multinomial;
+}
+
+/*! \brief Returns the run seed of the counter-based random streams (-rPHILOX).
+ */
+unsigned long long parseRandomSeed(){
+  return random_seed;
+}
+
 /*! \brief Returns true if only verifying the syntax of the input data.
  */
 int parseSyntaxCheck(){
@@ -408,6 +685,23 @@ int readMicrosatelliteMotifLengths(int argc, char **argv){
   return inputs;
 }
 
+/*! \brief Reads the argument of --reject: a radius, a comma and a file holding a row printed by -w.
+ */
+void readRejectTarget(char *argument){
+  char *end;
+  FILE *target;
+  int k;
+  reject_radius = strtod(argument, &end);
+  if(end == argument || *end != ',' || reject_radius < 0)
+    reportError("Mangled command line argument under --reject: must be --reject=radius,file with a nonnegative radius and the statistics of the input (-w) in file.");
+  target = fopen(end + 1, "r");
+  if(target == NULL) reportError("Could not open the file of observed statistics given to --reject.");
+  for(k = 0; k < REJECT_TARGET_STATISTICS; k++){
+    if(fscanf(target, "%lf", reject_target + k) != 1) reportError("The file of observed statistics given to --reject must hold a row printed by -w.");
+  }
+  fclose(target);
+}
+
 /*! \brief Parses command line arguments passed in to the program.
  */
 void parseArguments(int argc, char **argv){
@@ -424,7 +718,7 @@ void parseArguments(int argc, char **argv){
     char *currentArg = argv[i];
     if(currentArg[0] != '-') reportError("Arguments to OneSamp must start with hypens.");
     if(currentArg[1] == 'r'){
-      if(randomFlag == 1 || randomFlag == 0){
+      if(randomFlag != -1){
         reportError("Duplicate flag: -r");
       }
       if(strlen(currentArg) < 3){
@@ -443,6 +737,13 @@ void parseArguments(int argc, char **argv){
         randomFlag = 0; // Use GFSR random numbers
         resetgfsr();
       }
+      else if(strncmp(currentArg + 2, (char *) "PHILOX", 6) == 0){
+        randomFlag = 2; // Use counter-based random streams
+        char *seedEnd;
+        random_seed = strlen(currentArg) == 8 ? (unsigned long long) time(NULL) : strtoull(currentArg + 8, &seedEnd, 10);
+        if(strlen(currentArg) != 8 && (*seedEnd != '\0' || currentArg[8] == '-'))
+          reportError("Mangled command line argument under -r: the seed after -rPHILOX must be a nonnegative integer.");
+      }
       else{
         reportError("Mangled command line argument under -r: check documentation.");
       }
@@ -515,11 +816,87 @@ void parseArguments(int argc, char **argv){
       if(absentDataExtrapolate != FALSE) reportError("Duplicate flag: -a");
       absentDataExtrapolate = TRUE;
     }
+    else if(currentArg[1] == 'j') {
+      // Threads simulating iterations concurrently
+      if(threads != -1) reportError("Duplicate flag: -j");
+      threads = strlen(currentArg) == 2 ? omp_get_num_procs() : parsePositiveInt(i, argv);
+      if(threads == -1) threads = 0;
+    }
+    else if(currentArg[1] == 'k') {
+      // Simulate SNP generations as packed bit-planes
+      if(packed_snps != FALSE) reportError("Duplicate flag: -k");
+      packed_snps = TRUE;
+    }
+    else if(currentArg[1] == 'z') {
+      // Print each iteration as soon as it is done, reusing its buffers
+      if(streaming != FALSE) reportError("Duplicate flag: -z");
+      streaming = TRUE;
+    }
+    else if(currentArg[1] == 'n') {
+      // Final samples drawn from each simulated population
+      if(samples_per_population != -1) reportError("Duplicate flag: -n");
+      samples_per_population = parsePositiveInt(i, argv);
+      if(samples_per_population == -1) samples_per_population = 0;
+    }
+    else if(currentArg[1] == 'c') {
+      // Sample every duration of the bottleneck from a single trajectory
+      if(checkpoints != FALSE) reportError("Duplicate flag: -c");
+      checkpoints = TRUE;
+    }
+    else if(currentArg[1] == 'y') {
+      // Design of the parameters drawn for each iteration
+      if(design != -1) reportError("Duplicate flag: -y");
+      if(strcmp(currentArg + 2, "RANDOM") == 0) design = DESIGN_RANDOM;
+      else if(strcmp(currentArg + 2, "SOBOL") == 0) design = DESIGN_SOBOL;
+      else if(strcmp(currentArg + 2, "LHS") == 0) design = DESIGN_LATIN_HYPERCUBE;
+      else reportError("Mangled command line argument under -y: the design must be -yRANDOM, -ySOBOL or -yLHS.");
+    }
+    else if(currentArg[1] == 'q') {
+      // Approximate bottleneck generations by multinomial drift of allele counts
+      if(multinomial != FALSE) reportError("Duplicate flag: -q");
+      multinomial = TRUE;
+    }
     else if(currentArg[1] == 'o') {
       // Threshold to omit loci
       if(omitThreshold != -1) reportError("Duplicate flag: -o");
       omitThreshold = parsePositiveDouble(i, argv);
     }
+    else if(strncmp(currentArg, "--time-budget=", 14) == 0) {
+      // Keep simulating until the wall-clock budget is spent
+      char *end;
+      if(time_budget != -1) reportError("Duplicate flag: --time-budget");
+      time_budget = strtod(currentArg + 14, &end);
+      if(end == currentArg + 14 || *end != '\0' || time_budget < 0)
+        reportError("Mangled command line argument under --time-budget: must be a nonnegative number of seconds.");
+      time_budget_start = omp_get_wtime();
+    }
+    else if(strncmp(currentArg, "--replay-iteration=", 19) == 0) {
+      // Regenerate and dump a single iteration
+      char *end;
+      if(replay_iteration != -1) reportError("Duplicate flag: --replay-iteration");
+      replay_iteration = strtol(currentArg + 19, &end, 10);
+      if(end == currentArg + 19 || *end != '\0' || replay_iteration < 0)
+        reportError("Mangled command line argument under --replay-iteration: must be a nonnegative iteration number.");
+    }
+    else if(strncmp(currentArg, "--shard=", 8) == 0) {
+      // Run a part of the iterations of a larger run
+      char *end;
+      if(shard_first != -1) reportError("Duplicate flag: --shard");
+      shard_first = strtol(currentArg + 8, &end, 10);
+      if(end != currentArg + 8 && *end == ',') shard_total = strtol(end + 1, &end, 10);
+      if(*end != '\0' || shard_first < 0 || shard_total <= shard_first)
+        reportError("Mangled command line argument under --shard: must be --shard=first,total with the first iteration of the shard below the total of the run.");
+    }
+    else if(strcmp(currentArg, "--estimate-cost") == 0) {
+      // Time a few iterations and print the expected cost of the run
+      if(estimate_cost) reportError("Duplicate flag: --estimate-cost");
+      estimate_cost = TRUE;
+    }
+    else if(strncmp(currentArg, "--reject=", 9) == 0) {
+      // Drop samples far from the observed statistics before computing LD
+      if(reject_radius != -1) reportError("Duplicate flag: --reject");
+      readRejectTarget(currentArg + 9);
+    }
     else {
       reportError("Unknown flag passed in to OneSamp.");
     }
@@ -555,6 +932,15 @@ void parseArguments(int argc, char **argv){
     {
       parseFormFlag();
       if(!parseRawSample()) parseIterations();
+      parseThreads();
+      parseSamplesPerPopulation();
+      parseCheckpoints();
+      parseDesign();
+      parseFirstIteration();
+      parseRejectRadius();
+      parseEstimateCost();
+      parseReplayIteration();
+      parsePackedSNPs();
       parseNLoci();
       parseInputSamples();
       parseFormFlag();
@@ -565,7 +951,11 @@ void parseArguments(int argc, char **argv){
       if(!parseRawSample()) parseRFlag();
       if(!parseRawSample()) parseTheta(0);
     }
+    // Every operation past the syntax check simulates or computes statistics
+    snapshotRunConfig();
   }
+  // Work outside of the iterations draws from its own stream.
+  if(randomFlag != -1) useRandomStream(0, RANDOM_SUBSTREAM_SETUP);
   if(!parseSyntaxCheck() && !parseRawSample() && !parseExample() && !parseSingleGeneration() && !parseExamplePop()){
     reportArgumentError((char *) "%s: missing an operation to perform on the input file: -x (syntax check operation), -w (compute statistics of input sample), -g (simulate a single generation from an input population and display to standard out), -p (dump out an example population with known effective population size), or -e (compute stats of coalescent sample after a few generations have passed)");
   }
@@ -14,10 +14,42 @@
 #include <stdio.h>
 #include "../macro/refactor_macro.h"
 
+// CONSTANTS
+
+/*! \def REJECT_TARGET_STATISTICS
+ *  \brief Number of statistics in a row printed by -w, read by --reject.
+ */
+#define REJECT_TARGET_STATISTICS 9
+
+/*! \def SCHEDULE_BLOCK_ITERATIONS
+ *  \brief Number of iterations whose parameters are drawn at once under a time budget.
+ */
+#define SCHEDULE_BLOCK_ITERATIONS 1024
+
+// TYPES
+
+/*! \brief Configuration read by the simulation and statistics kernels.
+ *
+ * The accessors below validate their argument on every call; kernels read
+ * this copy instead, taken by snapshotRunConfig() once the arguments are
+ * validated. setNLoci() and setInputSamples() keep it current while the input
+ * is filtered, before anything is simulated.
+ */
+struct run_config {
+  int form_flag;
+  int num_loci;
+  int input_samples;
+};
+
+extern struct run_config run_config;
+
 // PROTOTYPES
 
+void snapshotRunConfig();
+
 void reportParseError(char *message, long row, long column);
 void reportError(char *message);
+void reportNote(char *message);
 void resetArguments();
 void parseArguments(int argc, char **argv);
 void flushArguments();
@@ -48,6 +80,29 @@ double parseMRate(int samp);
 double parseMRateMin();
 double parseMRateMax();
 int parseRFlag();
+int parseThreads();
+unsigned long long parseRandomSeed();
+int parsePackedSNPs();
+int parseStreaming();
+int parseMultinomial();
+int parseSamplesPerPopulation();
+int parseCheckpoints();
+int parseDesign();
+int parseFirstIteration();
+int parseDesignPoints();
+double parseRejectRadius();
+const double *parseRejectTarget();
+void readRejectTarget(char *argument);
+double parseTimeBudget();
+int timeBudgetSpent();
+int parseEstimateCost();
+int parseReplayIteration();
+int parseScheduleLength();
+void extendParameterSchedule(int length);
+void drawStruct7(int *choices, int first, int last);
+void drawStruct8(int *choices, int first, int last);
+void drawStruct9(double *choices, int first, int last);
+void drawStruct10(double *choices, int first, int last);
 int parseSyntaxCheck();
 int parseExample();
 int parseExamplePop();
@@ -38,6 +38,7 @@ TEST(arguments, testA){
   EXPECT_EQ(parseThetaMin(), 1);             // Verify theta parameter
   EXPECT_EQ(parseMRateMin(), 0.5);           // Verify mutation rate
   EXPECT_EQ(parseSyntaxCheck(), FALSE);   // Not doing a syntax check
+  EXPECT_EQ(parseThreads(), 1);           // Serial unless -j is given
   flushArguments();
 }
 
@@ -125,3 +126,129 @@ TEST(arguments, testC){
   EXPECT_EQ(parseExamplePop(), TRUE);
   flushArguments();
 }
+
+// onesamp -l19 -i71 -m -t8 -b10 -rGFSR -u0.12 -d10 -v0.1 -o1 -j3 -p
+TEST(arguments, testD){
+  int argc = 13;
+  char a0[] = {'o', 'n', 'e', 's', 'a', 'm', 'p', '\0'};
+  char a1[] = {'-', 'l', '1', '9', '\0'};
+  char a2[] = {'-', 'i', '7', '1', '\0'};
+  char a3[] = {'-', 'm', '\0'};
+  char a4[] = {'-', 't', '8', '\0'};
+  char a5[] = {'-', 'b', '1', '0', '\0'};
+  char a6[] = {'-', 'u', '0', '.', '1', '2', '\0'};
+  char a7[] = {'-', 'r', 'G', 'F', 'S', 'R', '\0'};
+  char a8[] = {'-', 'd', '1', '0', '\0'};
+  char a9[] = {'-', 'v', '0', '.', '1', '\0'};
+  char a10[] = {'-', 'o', '1', '\0'};
+  char a11[] = {'-', 'j', '3', '\0'};
+  char a12[] = {'-', 'p', '\0'};
+  char *argv[] = {a0, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12};
+  parseArguments(argc, argv);
+  EXPECT_EQ(parseThreads(), 3);           // Verify number of threads
+  EXPECT_EQ(parseIterations(), 8);        // Verify number of iterations
+  EXPECT_EQ(parseNLoci(), 19);            // Verify number of loci
+  EXPECT_EQ(parseInputSamples(), 71);     // Verify input size
+  EXPECT_EQ(run_config.form_flag, 1);     // Verify the copy read by kernels
+  EXPECT_EQ(run_config.num_loci, 19);
+  EXPECT_EQ(run_config.input_samples, 71);
+  flushArguments();
+}
+
+// onesamp -l19 -i71 -t<n> -b20,140 -rPHILOX7 -u0.1,0.2 -d1,4 -v0.1,0.3 -o1 -yLHS -s -p [--shard=<first>,12]
+// Shards of a run take disjoint parts of its Latin hypercube, so their
+// schedules concatenate to the schedule of the whole run.
+TEST(arguments, shards_split_design){
+  char a0[] = "onesamp";
+  char a1[] = "-l19";
+  char a2[] = "-i71";
+  char a3[] = "-t12";
+  char a4[] = "-b20,140";
+  char a5[] = "-u0.1,0.2";
+  char a6[] = "-rPHILOX7";
+  char a7[] = "-d1,4";
+  char a8[] = "-v0.1,0.3";
+  char a9[] = "-o1";
+  char a10[] = "-yLHS";
+  char a11[] = "-s";
+  char a12[] = "-p";
+  char first_iterations[] = "-t5";
+  char last_iterations[] = "-t7";
+  char first_shard[] = "--shard=0,12";
+  char last_shard[] = "--shard=5,12";
+  char *argv[] = {a0, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, first_shard};
+  int bottlenecks[12], durations[12];
+  double thetas[12], rates[12];
+  int j;
+  parseArguments(13, argv);
+  EXPECT_EQ(parseFirstIteration(), 0);
+  for(j = 0; j < 12; j++){
+    bottlenecks[j] = parseBottleneck(j);
+    durations[j] = parseBottleneckLength(j);
+    thetas[j] = parseTheta(j);
+    rates[j] = parseMRate(j);
+  }
+  flushArguments();
+  argv[3] = first_iterations;
+  parseArguments(14, argv);
+  for(j = 0; j < 5; j++){
+    EXPECT_EQ(parseBottleneck(j), bottlenecks[j]);
+    EXPECT_EQ(parseBottleneckLength(j), durations[j]);
+    EXPECT_EQ(parseTheta(j), thetas[j]);
+    EXPECT_EQ(parseMRate(j), rates[j]);
+  }
+  flushArguments();
+  argv[3] = last_iterations;
+  argv[13] = last_shard;
+  parseArguments(14, argv);
+  EXPECT_EQ(parseFirstIteration(), 5);
+  for(j = 0; j < 7; j++){
+    EXPECT_EQ(parseBottleneck(j), bottlenecks[5 + j]);
+    EXPECT_EQ(parseBottleneckLength(j), durations[5 + j]);
+    EXPECT_EQ(parseTheta(j), thetas[5 + j]);
+    EXPECT_EQ(parseMRate(j), rates[5 + j]);
+  }
+  flushArguments();
+}
+
+// onesamp -l19 -i71 -m -t61 -b20,140 -rPHILOX7 -u0.1,0.2 -d1,4 -v0.1,0.3 -o1 -yLHS -p
+// A Latin hypercube over as many iterations as bottleneck sizes draws every
+// size once, and spreads the other parameters evenly over their ranges.
+TEST(arguments, testE){
+  int argc = 13;
+  char a0[] = "onesamp";
+  char a1[] = "-l19";
+  char a2[] = "-i71";
+  char a3[] = "-m";
+  char a4[] = "-t61";
+  char a5[] = "-b20,140";
+  char a6[] = "-u0.1,0.2";
+  char a7[] = "-rPHILOX7";
+  char a8[] = "-d1,4";
+  char a9[] = "-v0.1,0.3";
+  char a10[] = "-o1";
+  char a11[] = "-yLHS";
+  char a12[] = "-p";
+  char *argv[] = {a0, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12};
+  int sizes[61] = {0};
+  int durations[4] = {0};
+  int below = 0;
+  int j;
+  parseArguments(argc, argv);
+  EXPECT_EQ(parseDesign(), DESIGN_LATIN_HYPERCUBE);
+  for(j = 0; j < 61; j++){
+    sizes[parseBottleneck(j) - 10]++;  // Pairs of individuals
+    durations[parseBottleneckLength(j) - 1]++;
+    EXPECT_GE(parseTheta(j), 0.1 - 1e-9);
+    EXPECT_LE(parseTheta(j), 0.3 + 1e-9);
+    below += parseMRate(j) < 0.15;
+  }
+  for(j = 0; j < 61; j++) EXPECT_EQ(sizes[j], 1);
+  for(j = 0; j < 4; j++){
+    EXPECT_GE(durations[j], 15);
+    EXPECT_LE(durations[j], 16);
+  }
+  EXPECT_GE(below, 30);
+  EXPECT_LE(below, 31);
+  flushArguments();
+}
@@ -29,10 +29,13 @@ struct gtype_type {
     ALLELE_TYPE *mgtype;
 };
 typedef struct gtype_type gtype_type;
-#define gfsr4() (((float) rand()) / INT_MAX ) / (GFSR_STYPE_UNSIGNED_MAX + 1.0)
+#define gfsr4() (rand() / (RAND_MAX + 1.0))
 #define disrand(l, t) ((int) ((((unsigned int) intrand())%((t) - (l) + 1)) + (l)))
 #define intrand() rand()
 #define randBit() disrand(0, 1)
+#define randomBit() randBit()
+#define randomBounded(n) disrand(0, (n) - 1)
+#define randomUniform() gfsr4()
 #endif
 
 int lociDirectInput = 0;
@@ -81,6 +84,88 @@ double allelePr(int val1, int val2, double theta){
   return result;
 }
 
+/*! \def coalescentFrequencies(int num_genes, int min_allele_count, double theta)
+ *  \brief Returns the distribution of the count of the mutant allele among num_genes coalescent genes
+ *  Entry j of the returned array (which the caller frees) is the probability
+ *  of j + min_allele_count mutant genes, for j up to num_genes / 2 - min_allele_count.
+ */
+double *coalescentFrequencies(int num_genes, int min_allele_count, double theta){
+  double *table = (double *)malloc((num_genes / 2 - min_allele_count + 1) * sizeof(double));
+  double total = 0;
+  int j, val1, val2;
+  // Every entry counts num_genes genes, so the falling quotient of allelePr(),
+  // which only depends on that total, is common to all of them and cancels
+  // out below. Leaving it out keeps the table linear in num_genes.
+  for(j = 0; j <= num_genes / 2 - min_allele_count; j++){
+    val1 = j + min_allele_count;
+    val2 = num_genes - val1;
+    table[j] = (val1 != 0 ? theta / val1 : 1.0) * (val2 != 0 ? theta / val2 : 1.0);
+    if(val1 == val2) table[j] /= 2;
+    total += table[j];
+  }
+  for(j = 0; j <= num_genes / 2 - min_allele_count; j++){
+    table[j] /= total;
+  }
+  return table;
+}
+
+/*! \brief Distribution of the mutant allele count of coalescent founders, set up for alias sampling.
+ *  Same as in the stats module of the main code base.
+ */
+struct founder_table {
+  int num_genes;
+  int min_allele_count;
+  int size;
+  int allocation;
+  double *threshold;
+  int *alias;
+};
+
+/*! \brief Sets table to the distribution of coalescentFrequencies(), paired up by Vose's method.
+ */
+void prepareFounderTable(struct founder_table *table, int num_genes, int min_allele_count, double theta){
+  double *probability = coalescentFrequencies(num_genes, min_allele_count, theta);
+  int *small, *large;
+  int num_small = 0, num_large = 0;
+  int j, s, l;
+  table->num_genes = num_genes;
+  table->min_allele_count = min_allele_count;
+  table->size = num_genes / 2 - min_allele_count + 1;
+  table->allocation = table->size;
+  table->threshold = (double *)malloc(table->size * sizeof(double));
+  table->alias = (int *)malloc(table->size * sizeof(int));
+  small = (int *)malloc(table->size * sizeof(int));
+  large = (int *)malloc(table->size * sizeof(int));
+  for(j = 0; j < table->size; j++){
+    table->threshold[j] = probability[j] * table->size;
+    table->alias[j] = j;
+    if(table->threshold[j] < 1) small[num_small++] = j;
+    else large[num_large++] = j;
+  }
+  while(num_small > 0 && num_large > 0){
+    s = small[--num_small];
+    l = large[num_large - 1];
+    table->alias[s] = l;
+    table->threshold[l] -= 1 - table->threshold[s];
+    if(table->threshold[l] < 1){
+      num_large--;
+      small[num_small++] = l;
+    }
+  }
+  while(num_large > 0) table->threshold[large[--num_large]] = 1;
+  while(num_small > 0) table->threshold[small[--num_small]] = 1;
+  free(small);
+  free(large);
+  free(probability);
+}
+
+/*! \brief Returns a mutant allele count drawn from a founder table, in constant time.
+ */
+int drawFounderCount(const struct founder_table *table){
+  int column = randomBounded(table->size);
+  return table->min_allele_count + (randomUniform() < table->threshold[column] ? column : table->alias[column]);
+}
+
 int main(int argc, char **argv) {
   printf("hope  not");
   if(argc != 6){
@@ -126,6 +211,15 @@ int main(int argc, char **argv) {
     males[0][k].mgtype = (ALLELE_TYPE *)malloc(extraProportionOfBufferLoci * parseNLoci()*sizeof(ALLELE_TYPE));
   }
 
+  int first_locus = 0;
+  int last_locus = extraProportionOfBufferLoci * parseNLoci();
+  struct founder_table founder_table_storage;
+  const struct founder_table *founders = &founder_table_storage;
+  prepareFounderTable(&founder_table_storage, 4 * parseBottleneck(), (int) ceil(parseMinAlleleFrequency() * 4 * parseBottleneck()), parseTheta(i));
+  const int *female_founders = NULL;
+  const int *male_founders = NULL;
+  int female_founder_count = parseBottleneck();
+  int male_founder_count = parseBottleneck();
   #include "../engine/refactor_coalescent_engine.txt"
   
   int num_loci = extraProportionOfBufferLoci * parseNLoci();
@@ -161,5 +255,7 @@ int main(int argc, char **argv) {
   }
   free(females[0]);
   free(males[0]);
+  free(founder_table_storage.threshold);
+  free(founder_table_storage.alias);
   return 0;
 }
@@ -8,9 +8,578 @@
 #include "../macro/refactor_macro.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <omp.h>
+
+// Missing alleles of every filtered input individual, copied onto the
+// simulated samples
+struct missing_masks input_missing_masks;
+
+// Seconds spent in each phase (COST_*) by the calibration of --estimate-cost
+double cost_seconds[COST_PHASES];
 
 // FUNCTIONS
 
+/*! \brief Returns the time at which a phase timed by stopCost() starts, if estimating the cost of a run.
+ */
+static inline double startCost(){
+  return parseEstimateCost() ? omp_get_wtime() : 0;
+}
+
+/*! \brief Adds the time since start, returned by startCost(), to a phase, if estimating the cost of a run.
+ */
+static inline void stopCost(int phase, double start){
+  if(parseEstimateCost()) cost_seconds[phase] += omp_get_wtime() - start;
+}
+
+/*! \brief Generates the coalescent founders of loci first_locus to last_locus - 1 of iteration i.
+ *
+ * The founders are written to females[0] and males[0]. Only those that are
+ * ancestors of the sample in the pedigree are given genes. The counts of the
+ * mutant allele are drawn from founders, prepared by prepareFounderTable() for
+ * the iteration.
+ */
+void simulateFounders(int i, const struct pedigree *ped, const struct founder_table *founders, struct gtype_type *females[2], struct gtype_type *males[2], int first_locus, int last_locus){
+  const int *female_founders = pedigreeAncestors(ped, 0, 0);
+  const int *male_founders = pedigreeAncestors(ped, 0, 1);
+  int female_founder_count = pedigreeAncestorCount(ped, 0, 0);
+  int male_founder_count = pedigreeAncestorCount(ped, 0, 1);
+  #include "../engine/refactor_coalescent_engine.txt"
+}
+
+/*! \brief Generates the parents of the sample at loci first_locus to last_locus - 1 of iteration i, by drift (-q).
+ *
+ * The founder gene pool of each locus is drawn as in the coalescent block,
+ * then carried through the bottleneck generations of the iteration as allele
+ * counts by driftAlleleCounts(). Only the individuals of the last generation
+ * that are ancestors of the sample in a pedigree of no generations are then
+ * given genes, drawn from its gene pool without replacement into females[0]
+ * and males[0]. The cost no longer depends on the bottleneck size.
+ */
+void simulateDriftedFounders(int i, const struct pedigree *ped, const struct founder_table *founders, struct gtype_type *females[2], struct gtype_type *males[2], int first_locus, int last_locus){
+  int num_genes = founders->num_genes;
+  ALLELE_TYPE alleles[DRIFT_MAX_ALLELES];
+  int counts[DRIFT_MAX_ALLELES];
+  int locus_index, j, a, sex, copy, founder, gene, numleft;
+  for(locus_index = first_locus; locus_index < last_locus; locus_index++){
+    // Two founder alleles and their frequencies, as in the coalescent block
+    alleles[0] = parseFormFlag() == 0 ? randomBounded(4) + 1 : initializeMicrosat1(locus_index);
+    alleles[1] = parseFormFlag() == 0 ? (alleles[0] + randomBounded(3)) % 4 + 1 : initializeMicrosat2(locus_index);
+    counts[0] = drawFounderCount(founders);
+    counts[1] = num_genes - counts[0];
+    driftAlleleCounts(alleles, counts, 2, num_genes, parseBottleneckLength(i), i, parseFormFlag() != 1 ? 0 : getMotifLengths()[locus_index]);
+
+    // Give the parents of the sample genes drawn from the last generation
+    numleft = num_genes;
+    for(sex = 0; sex < 2; sex++){
+      struct gtype_type *parents = sex == 0 ? females[0] : males[0];
+      for(copy = 0; copy < 2; copy++){
+        for(founder = 0; founder < pedigreeAncestorCount(ped, 0, sex); founder++){
+          j = pedigreeAncestors(ped, 0, sex)[founder];
+          gene = randomBounded(numleft);
+          for(a = 0; gene >= counts[a]; a++) gene -= counts[a];
+          (copy == 0 ? parents[j].pgtype : parents[j].mgtype)[locus_index] = alleles[a];
+          --counts[a];
+          --numleft;
+        }
+      }
+    }
+  }
+}
+
+/*! \brief Simulates loci first_locus to last_locus - 1 of iteration i into final_indivs_data[slot].
+ *
+ * Generates their founders and breeds them through the pedigree of the
+ * iteration, packed if packed is not NULL. If founders is NULL, the
+ * founders already in females[0] and males[0] are bred instead. The loci go
+ * through in tiles of pedigreeTileLoci() loci: a tile is bred from its
+ * founders to the final sample while it is in cache, before the next tile is
+ * started.
+ *
+ * Tiles touch disjoint loci of the shared scratch generations, so up to
+ * locus_threads threads simulate them at once. Each tile reads its own random
+ * stream if counter-based numbers are selected, so the result does not depend
+ * on the number of threads; otherwise the extra threads are seeded from the
+ * calling thread.
+ */
+void simulateLoci(int i, int slot, const struct pedigree *ped, const struct founder_table *founders, struct gtype_type *females[2], struct gtype_type *males[2], struct packed_buffers *packed, int first_locus, int last_locus, int locus_threads){
+  int tile = pedigreeTileLoci(ped, packed != NULL ? 1 : 8 * sizeof(ALLELE_TYPE));
+  int num_tiles = (last_locus - first_locus + tile - 1) / tile;
+  int team = num_tiles < locus_threads ? num_tiles : locus_threads;
+  GFSR_STYPE *seeds = NULL;
+  int t;
+  if(team > 1){
+    seeds = (GFSR_STYPE *)malloc(team * P() * sizeof(GFSR_STYPE));
+    splitRandomState(team, seeds);
+  }
+  #pragma omp parallel num_threads(team) if(team > 1) private(t)
+  {
+    if(team > 1) loadThreadRandomState(omp_get_thread_num(), seeds);
+    #pragma omp for schedule(dynamic, 1)
+    for(t = 0; t < num_tiles; t++){
+      int tile_first = first_locus + t * tile;
+      int tile_last = tile_first + tile < last_locus ? tile_first + tile : last_locus;
+      double cost_start = startCost();
+      useRandomStream(i, RANDOM_SUBSTREAM_TILE(tile_first));
+      if(founders != NULL && parseMultinomial()) simulateDriftedFounders(i, ped, founders, females, males, tile_first, tile_last);
+      else if(founders != NULL) simulateFounders(i, ped, founders, females, males, tile_first, tile_last);
+      stopCost(COST_FOUNDERS, cost_start);
+      cost_start = startCost();
+      if(packed != NULL) dropPackedPedigreeLoci(ped, packed, females, males, final_indivs_data[slot], i, tile_first, tile_last);
+      else dropPedigreeLoci(ped, females, males, final_indivs_data[slot], i, tile_first, tile_last);
+      stopCost(COST_GENERATIONS, cost_start);
+    }
+  }
+  free(seeds);
+}
+
+/*! \brief Returns how many samples, each in its own slot, every iteration gives.
+ *
+ * That is parseSamplesPerPopulation() for each sampled duration: every one in
+ * the range of -d with -c, or a single one.
+ */
+int iterationSlots(){
+  if(parseRawSample()) return 1;
+  if(!parseCheckpoints()) return parseSamplesPerPopulation();
+  return parseSamplesPerPopulation() * (parseBottleneckLengthMax() - parseBottleneckLengthMin() + 1);
+}
+
+/*! \brief Returns the number of loci held by each sample and generation, replacement loci included.
+ *
+ * Room is left for as many replacement loci as requested loci. Packed loci
+ * are simulated in whole words, so with -k the replacements start at the word
+ * after the requested loci and are a whole number of words.
+ */
+int bufferLoci(){
+  if(parsePackedSNPs()) return 2 * packedWords(parseNLoci()) * PACKED_WORD_BITS;
+  return extraProportionOfBufferLoci * parseNLoci();
+}
+
+/*! \brief Simulates iteration i into final_indivs_data[slot] onwards.
+ *
+ * Draws the pedigree of the iteration, simulates the requested loci through
+ * it, then replaces the loci that came out monomorphic with polymorphic ones
+ * simulated through the same pedigree, and adds the missing data pattern of
+ * the input. Replacement loci are simulated only as many as are still needed,
+ * up to as many as the requested loci, for every run alike. The females,
+ * males, pedigree and founder table are owned by the calling thread; the
+ * table is kept from one iteration to the next while it fits. The slot is
+ * the first of the iteration, unless iterations are streamed (-z) and each
+ * thread reuses its own. If packed is not NULL, the generations are simulated
+ * packed (SNPs only). The loci are shared among locus_threads threads. With
+ * -q, the bottleneck generations are drifted as allele counts and only the
+ * sample is bred.
+ *
+ * With -n, parseSamplesPerPopulation() samples are bred from the last
+ * generation of the same pedigree into consecutive slots, whose samples are
+ * consecutive in memory. With -c, the pedigree runs for the longest duration
+ * and as many samples are also bred after each shorter one, shortest first.
+ * Each sample gets its own replacement loci and missing data.
+ */
+void simulateIteration(int i, int slot, struct gtype_type *females[2], struct gtype_type *males[2], struct pedigree *ped, struct founder_table *founders, struct packed_buffers *packed, int locus_threads){
+  int j;
+  int k;
+  int s;
+  int final_indivs_count = parseInputSamples();
+  int num_samples = iterationSlots();
+  int max_loci = bufferLoci();
+  int num_genes = 4 * parseBottleneck(i);
+  int *monomorphic = (int *)malloc(num_samples * parseNLoci() * sizeof(int));
+  int generations = parseCheckpoints() ? parseBottleneckLengthMax() : parseBottleneckLength(i);
+  int *num_monomorphic = (int *)calloc(num_samples, sizeof(int));
+  int *replaced = (int *)calloc(num_samples, sizeof(int));
+  int needed = 0;
+  int first_locus;
+  int last_locus;
+  int last_replacement;
+  int simulated;
+  // Time of the whole iteration, less the phases timed within it
+  double cost_start = startCost();
+  double cost_within = cost_seconds[COST_FOUNDERS] + cost_seconds[COST_GENERATIONS];
+
+  // Draw everything in this iteration from its own stream, if enabled
+  useRandomStream(i, RANDOM_SUBSTREAM_SIMULATION);
+
+  // Choose who mates with whom in every generation, then simulate the loci
+  if(parseMultinomial()) drawPedigree(ped, 0, parseBottleneck(i), parseSamplesPerPopulation() * final_indivs_count);
+  else drawCheckpointPedigree(ped, parseCheckpoints() ? parseBottleneckLengthMin() : generations, generations, parseBottleneck(i), parseSamplesPerPopulation() * final_indivs_count);
+  prepareFounderTable(founders, num_genes, (int) ceil(parseMinAlleleFrequency() * num_genes), parseTheta(i));
+  stopCost(COST_PEDIGREE, cost_start);
+  cost_start = startCost();
+  simulateLoci(i, slot, ped, founders, females, males, packed, 0, parseNLoci(), locus_threads);
+
+  // Replace monomorphic loci if possible by simulating extra loci
+  for(s = 0; s < num_samples; s++){
+    for(j = 0; j < parseNLoci(); j++){
+      if(variantsOfFinalLocus(slot + s, j) < 2) monomorphic[s * parseNLoci() + num_monomorphic[s]++] = j;
+    }
+    if(num_monomorphic[s] > needed) needed = num_monomorphic[s];
+  }
+  // Every sample gets as many replacement candidates as requested loci. Packed
+  // loci are simulated in whole words, so the replacements start at the word
+  // after the requested loci and a word left partly unused carries over to the
+  // next batch
+  first_locus = packed != NULL ? packedWords(parseNLoci()) * PACKED_WORD_BITS : parseNLoci();
+  last_replacement = first_locus + parseNLoci();
+  simulated = first_locus;
+  while(needed > 0){
+    last_locus = first_locus + needed;
+    if(last_locus > last_replacement) last_locus = last_replacement;
+    if(!(first_locus < last_locus)) break;
+    if(simulated < last_locus){
+      int last_simulated = packed != NULL ? packedWords(last_locus) * PACKED_WORD_BITS : last_locus;
+      if(last_simulated > max_loci) last_simulated = max_loci;
+      simulateLoci(i, slot, ped, founders, females, males, packed, simulated, last_simulated, locus_threads);
+      simulated = last_simulated;
+    }
+    needed = 0;
+    for(s = 0; s < num_samples; s++){
+      for(j = first_locus; j < last_locus && replaced[s] < num_monomorphic[s]; j++){
+        int tempGene1;
+        int tempGene2;
+        if(variantsOfFinalLocus(slot + s, j) < 2) continue;
+        for(k = 0; k < parseInputSamples(); k++){
+          loadFinalGenotype(slot + s, k, j, &tempGene1, &tempGene2);
+          storeFinalGenotype(slot + s, k, monomorphic[s * parseNLoci() + replaced[s]], &tempGene1, &tempGene2);
+        }
+        replaced[s]++;
+      }
+      if(num_monomorphic[s] - replaced[s] > needed) needed = num_monomorphic[s] - replaced[s];
+    }
+    first_locus = last_locus;
+  }
+  free(monomorphic);
+  free(num_monomorphic);
+  free(replaced);
+
+  // Add in missing data in coalescent population to mimic input population.
+  //double missingDataProbability = getProportionMissingData();
+
+  if(!parseExamplePop()){
+    useRandomStream(i, RANDOM_SUBSTREAM_MISSING);
+    for(s = 0; s < num_samples; s++){
+      for(k = 0; k < parseInputSamples(); k++){
+        int maskFromInputSample = disrand(0, parseInputSamples() - 1);
+        applyMissingMask(&input_missing_masks, maskFromInputSample, &final_indivs_data[slot + s][k]);
+      }
+    }
+  }
+  stopCost(COST_SAMPLE, cost_start);
+  if(parseEstimateCost()) cost_seconds[COST_SAMPLE] -= cost_seconds[COST_FOUNDERS] + cost_seconds[COST_GENERATIONS] - cost_within;
+
+  //writeoutput(final_indivs_data, final_indivs_count);
+}
+
+/*! \brief Computes the output statistics of iteration i, held in final_indivs_data[slot], but iis.
+ *
+ * Results are stored at index slot of each of the num_slots long statistics in
+ * doubleData. iis costs more than all of them together.
+ */
+void computeSummaryStatistics(int i, int slot, int num_slots, int **numberOfAlleles, double *doubleData, int ***gType, int ***gcount){
+  double *mnals = doubleData;
+  double *m = doubleData + 1 * num_slots;
+  double *lnbeta = doubleData + 3 * num_slots;
+  double *hetx = doubleData + 4 * num_slots;
+  double *mnehet = doubleData + 5 * num_slots;
+  double *mhomo = doubleData + 6 * num_slots;
+  double *varhomo = doubleData + 7 * num_slots;
+  double *skhomo = doubleData + 8 * num_slots;
+  double *kurhomo = doubleData + 9 * num_slots;
+  double *ne = doubleData + 10 * num_slots;
+
+  double cost_start;
+
+  //writeoutput(final_indivs_data, parseInputSamples());
+
+  // Statistic 6: mnals
+  // Summarize information about alleles
+  cost_start = startCost();
+  countsAssist(&numberOfAlleles, final_indivs_data, mnals, gType, &gcount, slot);
+  stopCost(COST_MNALS, cost_start);
+
+  // Statistic 1: m
+  // Only do next call if we're not using SNPs
+  // Calculate range, m, change in frequency of alleles
+  cost_start = startCost();
+  sortMAssist(numberOfAlleles, num_slots, m, gType, &gcount, slot);
+  stopCost(COST_M, cost_start);
+
+  // Statistic 3: lnbeta
+  // Only do next call if we're not using SNPs
+  // Calculate beta statistic
+  cost_start = startCost();
+  betaAssist(numberOfAlleles, num_slots, lnbeta, gType, &gcount, slot);
+  stopCost(COST_LNBETA, cost_start);
+
+  // Both statistics below only need to know which genotypes are homozygous
+  // or missing, so that is packed once and counted a word of loci at a time.
+  cost_start = startCost();
+  struct zygosity_planes zygosity;
+  allocateZygosityPlanes(&zygosity, parseInputSamples(), parseNLoci());
+  packZygosity(&zygosity, final_indivs_data[slot], parseNLoci());
+
+  // Statistics 4 and 5: hetx, mnehet
+  // Calculate the excess heterozygosity
+  hetexcessPacked(numberOfAlleles, &zygosity, hetx, mnehet, gType, &gcount, slot);
+  stopCost(COST_HETX, cost_start);
+
+  // Statistics 7 and 8 (and 9 and 10): mhomo, varhomo, skhomo, kurhomo
+  // Calculate mean, variance, skew, and kurtosis of heterozygosity
+  cost_start = startCost();
+  multihPacked(&zygosity, mhomo, varhomo, skhomo, kurhomo, slot);
+  deallocateZygosityPlanes(&zygosity);
+  stopCost(COST_MHOMO, cost_start);
+
+  // Statistic 0: ne
+  // Calculate Ne
+  ne[slot] = parseRawSample() ? -1 : (2*parseBottleneck(i)+(double)(1.0/(2*parseBottleneck(i)))+0.5);
+}
+
+/*! \brief Computes iis of the sample in final_indivs_data[slot], after computeSummaryStatistics().
+ *
+ * Only the pairs among its first num_loci loci are counted, and they are
+ * shared among locus_threads threads.
+ */
+void computeLinkageStatistic(int slot, int num_slots, int num_loci, int **numberOfAlleles, double *doubleData, int ***gType, int ***gcount, int locus_threads){
+  double *iis = doubleData + 2 * num_slots;
+  double cost_start = startCost();
+
+  // Statistic 2: iis
+  // Calculate Burrows Weir stat from Vitalis and Couvet, tallying the
+  // genotypes of each pair of loci from planes of every allele
+  struct allele_planes planes;
+  allocateAllelePlanes(&planes, run_config.input_samples, num_loci, numberOfAlleles[slot]);
+  packAllelePlanes(&planes, final_indivs_data[slot], numberOfAlleles[slot], gType[slot]);
+  twolocusiisPacked(numberOfAlleles, &planes, iis, slot, locus_threads);
+  deallocateAllelePlanes(&planes);
+  stopCost(COST_IIS, cost_start);
+}
+
+/*! \brief Computes all output statistics of iteration i, held in final_indivs_data[slot].
+ *
+ * Results are stored at index slot of each of the num_slots long statistics in
+ * doubleData. The pairs of loci for iis are shared among locus_threads threads.
+ */
+void computeIterationStatistics(int i, int slot, int num_slots, int **numberOfAlleles, double *doubleData, int ***gType, int ***gcount, int locus_threads){
+  computeSummaryStatistics(i, slot, num_slots, numberOfAlleles, doubleData, gType, gcount);
+  computeLinkageStatistic(slot, num_slots, parseNLoci(), numberOfAlleles, doubleData, gType, gcount, locus_threads);
+}
+
+/*! \def EARLY_STATISTICS
+ *  \brief Number of statistics compared with the observed ones before iis is computed.
+ */
+#define EARLY_STATISTICS 7
+
+/*! \brief Statistics compared by rScript.r but iis: their index in doubleData, and their column in a row printed by -w.
+ */
+static const int early_statistics[EARLY_STATISTICS][2] = {{1, 7}, {3, 8}, {4, 2}, {5, 3}, {0, 4}, {6, 5}, {7, 6}};
+
+/*! \brief Computes the distance of every sample from the observed statistics, over the statistics known before iis.
+ *
+ * Each statistic is normalised by its mean and standard deviation over all
+ * num_slots samples, as normalise() in rScript.r does; a statistic that does
+ * not vary or is not finite is left out, as it adds nothing there. Adding iis
+ * can only lengthen the distance, so a sample further than the radius of
+ * acceptance already is outside it.
+ */
+void partialDistances(int num_slots, const double *doubleData, const double *target, double *distances){
+  int k, slot;
+  for(slot = 0; slot < num_slots; slot++) distances[slot] = 0;
+  for(k = 0; k < EARLY_STATISTICS; k++){
+    const double *values = doubleData + early_statistics[k][0] * num_slots;
+    double observed = target[early_statistics[k][1]];
+    double mean = 0;
+    double variance = 0;
+    for(slot = 0; slot < num_slots; slot++) mean += values[slot];
+    mean /= num_slots;
+    for(slot = 0; slot < num_slots; slot++) variance += (values[slot] - mean) * (values[slot] - mean);
+    variance /= num_slots - 1;
+    if(!isfinite(variance) || variance == 0) continue;
+    for(slot = 0; slot < num_slots; slot++) distances[slot] += (values[slot] - observed) * (values[slot] - observed) / variance;
+  }
+  for(slot = 0; slot < num_slots; slot++) distances[slot] = sqrt(distances[slot]);
+}
+
+/*! \brief Prints the statistics stored at index slot of doubleData as one row.
+ *
+ * With several samples per population (-n or -c), the row ends with the
+ * iteration i the sample was drawn from, so that samples of one population can
+ * be told apart from independent ones. With -c, it is followed by the duration
+ * of the bottleneck the sample was bred after.
+ */
+void printIterationStatistics(int i, int slot, int num_slots, double *doubleData){
+  double *mnals = doubleData;
+  double *m = doubleData + 1 * num_slots;
+  double *iis = doubleData + 2 * num_slots;
+  double *lnbeta = doubleData + 3 * num_slots;
+  double *hetx = doubleData + 4 * num_slots;
+  double *mnehet = doubleData + 5 * num_slots;
+  double *mhomo = doubleData + 6 * num_slots;
+  double *varhomo = doubleData + 7 * num_slots;
+  double *ne = doubleData + 10 * num_slots;
+  printf("%f %f %f %f %f %f %f %f %f", ne[slot], iis[slot], hetx[slot], mnehet[slot], mnals[slot], mhomo[slot], varhomo[slot], m[slot], lnbeta[slot]);
+  if(iterationSlots() > 1) printf(" %d", i);
+  if(parseCheckpoints() && !parseRawSample()) printf(" %d", parseBottleneckLengthMin() + slot % iterationSlots() / parseSamplesPerPopulation());
+  printf("\n");
+}
+
+/*! \brief Names of the phases timed by --estimate-cost, in the order of COST_*.
+ */
+static const char *cost_phase_names[COST_PHASES] = {"pedigree and founder table", "founders", "bottleneck generations", "replacement loci and missing data", "mnals", "m", "lnbeta", "hetx, mnehet", "mhomo, varhomo, skhomo, kurhomo", "iis"};
+
+/*! \def allocationBytes(size)
+ *  \brief Bytes taken by one block of size bytes from malloc.
+ */
+#define allocationBytes(size) ((double) (size) + ALLOCATION_OVERHEAD)
+
+/*! \brief Models the peak memory, in bytes, of a run on num_threads threads keeping num_slots samples at once.
+ *
+ * Adds up the blocks allocated by onesamp_engine() for the input, for each
+ * sample and its statistics, and for the generations and pedigree of each
+ * thread. The packed planes of -k, a sixteenth of the generations, and the
+ * program itself are left out.
+ */
+double estimatePeakMemory(int num_threads, int num_slots){
+  double loci = bufferLoci();
+  int brood = parseBottleneckMax() > parseSamplesPerPopulation() * parseInputSamples() ? parseBottleneckMax() : parseSamplesPerPopulation() * parseInputSamples();
+  double input = allocationBytes(parseInputSamplesAllocation() * STRUCT_GTYPE_SIZE) + 2.0 * parseInputSamplesAllocation() * allocationBytes(parseNLociAllocation() * sizeof(ALLELE_TYPE));
+  double slot = allocationBytes(parseNLociAllocation() * sizeof(int))
+    + 2 * (allocationBytes(parseNLociAllocation() * sizeof(int *)) + parseNLociAllocation() * allocationBytes(MAX_NO_ALLELES * sizeof(int)))
+    + parseInputSamples() * (STRUCT_GTYPE_SIZE + 2 * allocationBytes(loci * sizeof(ALLELE_TYPE)))
+    + 11 * sizeof(double) + sizeof(struct gtype_type *);
+  double thread = 4 * (allocationBytes(parseBottleneckMax() * STRUCT_GTYPE_SIZE) + 2.0 * parseBottleneckMax() * allocationBytes(loci * sizeof(ALLELE_TYPE)))
+    + 2 * allocationBytes((3.0 * parseBottleneckLengthMax() + 1) * brood * sizeof(int))
+    + allocationBytes(2.0 * (parseBottleneckLengthMax() + 1) * brood * sizeof(int));
+  double schedule = 4.0 * parseScheduleLength() * sizeof(double);
+  return input + num_slots * slot + num_threads * thread + schedule;
+}
+
+/*! \brief Estimates the cost of the run from a few of its iterations, and prints it instead of running it (--estimate-cost).
+ *
+ * Up to ESTIMATE_ITERATIONS iterations spread over the schedule are simulated
+ * and summarized on one thread, with every phase timed, into the num_slots
+ * slots allocated for them. iis is timed on the pairs among the first
+ * ESTIMATE_LD_LOCI loci and scaled to all pairs. Their output goes to a
+ * scratch file whose size gives the size of the whole output. The CPU time of
+ * each phase and in all is then scaled to every iteration; the wall-clock time
+ * assumes threads are kept busy, and the peak memory comes from
+ * estimatePeakMemory().
+ */
+void estimateCost(int num_threads, int num_slots, int **numberOfAlleles, double *doubleData, int ***gType, int ***gcount){
+  int num_samples = iterationSlots();
+  int calibration = num_slots / num_samples;
+  int ld_loci = parseNLoci() < ESTIMATE_LD_LOCI ? parseNLoci() : ESTIMATE_LD_LOCI;
+  double scale = (double) parseIterations() / calibration;
+  double total = 0;
+  long header_bytes = 0;
+  long row_bytes;
+  FILE *scratch = tmpfile();
+  int saved_stdout;
+  int c, j, phase;
+
+  if(scratch == NULL) reportError("Could not create a scratch file for --estimate-cost.");
+  memset(cost_seconds, 0, sizeof(cost_seconds));
+  fflush(stdout);
+  saved_stdout = dup(fileno(stdout));
+  dup2(fileno(scratch), fileno(stdout));
+  if(parseExamplePop()){
+    writeOutputHeader();
+    fflush(stdout);
+    header_bytes = lseek(fileno(scratch), 0, SEEK_CUR);
+  }
+
+  // One thread, and so is iis, so that the CPU time is that of one thread
+  #pragma omp parallel num_threads(1) private(c, j)
+  {
+    struct gtype_type *females[2], *males[2];
+    struct pedigree ped;
+    struct founder_table founders;
+    struct packed_buffers packed;
+    allocateGenerationBuffers(females, males, parseBottleneckMax(), bufferLoci());
+    allocatePedigree(&ped, parseBottleneckLengthMax(), parseBottleneckMax(), parseSamplesPerPopulation() * parseInputSamples());
+    allocateFounderTable(&founders);
+    if(parsePackedSNPs()) allocatePackedBuffers(&packed, parseBottleneckMax(), parseSamplesPerPopulation() * parseInputSamples(), bufferLoci());
+    for(c = 0; c < calibration; c++){
+      int i = (int) ((long long) c * parseIterations() / calibration);
+      simulateIteration(i, c * num_samples, females, males, &ped, &founders, parsePackedSNPs() ? &packed : NULL, 1);
+      for(j = c * num_samples; j < (c + 1) * num_samples; j++){
+        if(parseExamplePop()){
+          writeOutputSample(final_indivs_data[j], parseInputSamples());
+          continue;
+        }
+        computeSummaryStatistics(i, j, num_slots, numberOfAlleles, doubleData, gType, gcount);
+        // Only the first loci are paired
+        computeLinkageStatistic(j, num_slots, ld_loci, numberOfAlleles, doubleData, gType, gcount, 1);
+        printIterationStatistics(i, j, num_slots, doubleData);
+      }
+    }
+    deallocateGenerationBuffers(females, males, parseBottleneckMax());
+    deallocatePedigree(&ped);
+    deallocateFounderTable(&founders);
+    if(parsePackedSNPs()) deallocatePackedBuffers(&packed, parseBottleneckMax(), parseSamplesPerPopulation() * parseInputSamples());
+  }
+  if(ld_loci > 1) cost_seconds[COST_IIS] *= (double) parseNLoci() * (parseNLoci() - 1) / (ld_loci * (ld_loci - 1));
+
+  fflush(stdout);
+  row_bytes = lseek(fileno(scratch), 0, SEEK_CUR) - header_bytes;
+  dup2(saved_stdout, fileno(stdout));
+  close(saved_stdout);
+  fclose(scratch);
+
+  printf("Estimated cost of %d iterations, from %d of them", parseIterations(), calibration);
+  if(!parseExamplePop()) printf(" (iis from the pairs of %d of %d loci)", ld_loci, parseNLoci());
+  printf("\n");
+  for(phase = 0; phase < COST_PHASES; phase++){
+    if(parseExamplePop() && phase >= COST_MNALS) break;
+    printf("%-40s %14.3f s CPU\n", cost_phase_names[phase], cost_seconds[phase] * scale);
+    total += cost_seconds[phase] * scale;
+  }
+  printf("%-40s %14.3f s CPU\n", "total", total);
+  printf("%-40s %14.3f s on %d threads\n", "wall clock", total / num_threads, num_threads);
+  printf("%-40s %14.3f MB\n", "peak memory", estimatePeakMemory(num_threads, parseStreaming() ? num_threads * num_samples : parseIterations() * num_samples) / 1048576);
+  printf("%-40s %14.3f MB\n", "output", (header_bytes + row_bytes * scale) / 1048576);
+}
+
+/*! \brief Regenerates iteration i alone and dumps it (--replay-iteration).
+ *
+ * Every draw of an iteration comes from its own counter-based streams, and
+ * its parameters from the schedule, so it is simulated into the first slots
+ * exactly as in the full run, at the cost of one iteration. Its parameters and
+ * population are printed, then for each sample the allele tables the
+ * statistics are computed from (numberOfAlleles, gType, gcount) and its row
+ * of statistics.
+ */
+void replayIteration(int i, int num_slots, int **numberOfAlleles, double *doubleData, int ***gType, int ***gcount){
+  int num_samples = iterationSlots();
+  struct gtype_type *females[2], *males[2];
+  struct pedigree ped;
+  struct founder_table founders;
+  struct packed_buffers packed;
+  int j;
+
+  if(parseTimeBudget() >= 0) extendParameterSchedule(i + 1);
+  allocateGenerationBuffers(females, males, parseBottleneckMax(), bufferLoci());
+  allocatePedigree(&ped, parseBottleneckLengthMax(), parseBottleneckMax(), parseSamplesPerPopulation() * parseInputSamples());
+  allocateFounderTable(&founders);
+  if(parsePackedSNPs()) allocatePackedBuffers(&packed, parseBottleneckMax(), parseSamplesPerPopulation() * parseInputSamples(), bufferLoci());
+  simulateIteration(i, 0, females, males, &ped, &founders, parsePackedSNPs() ? &packed : NULL, parseThreads());
+  deallocateGenerationBuffers(females, males, parseBottleneckMax());
+  deallocatePedigree(&ped);
+  deallocateFounderTable(&founders);
+  if(parsePackedSNPs()) deallocatePackedBuffers(&packed, parseBottleneckMax(), parseSamplesPerPopulation() * parseInputSamples());
+
+  printf("Replay of iteration %d: bottleneck %d, duration %d, theta %g, mutation rate %g\n", i, parseBottleneck(i), parseBottleneckLength(i), parseTheta(i), parseMRate(i));
+  writeOutputHeader();
+  for(j = 0; j < num_samples; j++) writeOutputSample(final_indivs_data[j], parseInputSamples());
+  if(parseExamplePop()) return;
+  for(j = 0; j < num_slots; j++) computeIterationStatistics(i, j, num_slots, numberOfAlleles, doubleData, gType, gcount, parseThreads());
+  numberOfAllelesDump(numberOfAlleles, num_slots);
+  gTypeDump(gType, numberOfAlleles, num_slots);
+  gcountDump(gcount, numberOfAlleles, num_slots);
+  printf("Auto-generated statistics output.\n");
+  for(j = 0; j < num_slots; j++) printIterationStatistics(i, j, num_slots, doubleData);
+}
+
 /*! \brief Runs main engine for OneSamp.
  *
  */
@@ -47,41 +616,27 @@ int onesamp_engine(int argc, char **argv){
   int initial_indivs_count = parseInputSamples();
   int final_indivs_count = parseInputSamples();
 
+  // Threads simulate separate iterations; with fewer iterations than threads,
+  // the threads left over share the loci of each iteration.
+  int num_threads = parseThreads() < parseIterations() ? parseThreads() : parseIterations();
+  int locus_threads = parseThreads() / num_threads;
+  if(num_threads > 1 && locus_threads > 1) omp_set_max_active_levels(2);
+
+  // A sample and its statistics are kept for every iteration, unless they are
+  // streamed (-z): then each thread reuses a single slot. Each population
+  // gives iterationSlots() samples in consecutive slots.
+  int num_samples = iterationSlots();
+  int num_slots = parseStreaming() ? num_threads * num_samples : parseIterations() * num_samples;
+  if(parseEstimateCost()) num_slots = (parseIterations() < ESTIMATE_ITERATIONS ? parseIterations() : ESTIMATE_ITERATIONS) * num_samples;
+  if(parseReplayIteration() >= 0) num_slots = num_samples;
+
   // Allocate space to store results of statistics compuation
-  allocateOneSampMemory(parseInputSamplesAllocation(), parseBottleneckMax(), parseInputSamples(), parseIterations(), parseNLociAllocation(), numberOfAllelesPtr, doubleDataPtr, gTypePtr, gcountPtr);
+  allocateOneSampMemory(parseInputSamplesAllocation(), parseBottleneckMax(), parseInputSamples(), num_slots, parseNLociAllocation(), numberOfAllelesPtr, doubleDataPtr, gTypePtr, gcountPtr);
 
-  double *mnals = doubleData;
-  double *m = doubleData + 1 * parseIterations();
-  double *iis = doubleData + 2 * parseIterations();
-  double *lnbeta = doubleData + 3 * parseIterations();
-  double *hetx = doubleData + 4 * parseIterations();
-  double *mnehet = doubleData + 5 * parseIterations();
-  double *mhomo = doubleData + 6 * parseIterations();
-  double *varhomo = doubleData + 7 * parseIterations();
-  double *skhomo = doubleData + 8 * parseIterations();
-  double *kurhomo = doubleData + 9 * parseIterations();
-  double *ne = doubleData + 10 * parseIterations();
-
-  // Simulate the generations
   int i;
   int j;
-  int k;
-  int current;
-  int next;
-  int temp;
-
-  // Allocate arrays to store intermediate generations.
-  struct gtype_type *females[2], *males[2];
-  for(i = 0; i < 2; i++){
-    females[i] = (struct gtype_type *)malloc(parseBottleneckMax() * STRUCT_GTYPE_SIZE);
-    males[i] = (struct gtype_type *)malloc(parseBottleneckMax() * STRUCT_GTYPE_SIZE);
-    for(j = 0; j < parseBottleneckMax(); j++){
-      females[i][j].pgtype = (ALLELE_TYPE *)malloc(extraProportionOfBufferLoci * parseNLoci()*sizeof(ALLELE_TYPE));
-      males[i][j].pgtype = (ALLELE_TYPE *)malloc(extraProportionOfBufferLoci * parseNLoci()*sizeof(ALLELE_TYPE));
-      females[i][j].mgtype = (ALLELE_TYPE *)malloc(extraProportionOfBufferLoci * parseNLoci()*sizeof(ALLELE_TYPE));
-      males[i][j].mgtype = (ALLELE_TYPE *)malloc(extraProportionOfBufferLoci * parseNLoci()*sizeof(ALLELE_TYPE));
-    }
-  }
+  // Samples dropped by --reject
+  unsigned char *rejected = NULL;
 
   if(!parseExamplePop()){
     parseFromFile(FALSE, stdin, syntax_results);
@@ -107,8 +662,17 @@ int onesamp_engine(int argc, char **argv){
         final_indivs_data[i][j].mgtype = (ALLELE_TYPE *)malloc(parseNLoci() * sizeof(ALLELE_TYPE));
       }
     }
-    // We are doing just one iteration, so pick that value
-    assort(2 * parseBottleneck(0), final_indivs_data[0], initial_indivs_data, initial_indivs_data, parseInputSamples(), 0, num_loci);
+    // We are doing just one iteration, so pick that value. Breeding the sample
+    // from the input is a pedigree of no bottleneck generations, so its loci
+    // can be shared among threads.
+    {
+      struct gtype_type *parents[2] = {initial_indivs_data, initial_indivs_data};
+      struct pedigree ped;
+      allocatePedigree(&ped, 0, parseInputSamples(), 2 * parseBottleneck(0));
+      drawPedigree(&ped, 0, parseInputSamples(), 2 * parseBottleneck(0));
+      simulateLoci(0, 0, &ped, NULL, parents, parents, NULL, 0, num_loci, parseThreads());
+      deallocatePedigree(&ped);
+    }
     writeoutput(final_indivs_data, 2 * parseBottleneck(0));
     for(i = 0; i < 1; i++) {
       for(j = 0; j < 2 * parseBottleneck(0); j++){
@@ -121,11 +685,20 @@ int onesamp_engine(int argc, char **argv){
     return 0;
   }
 
+  if(parseMultinomial() && !parseRawSample()){
+    reportNote((char *) "%s: -q drifts the allele counts of each locus through the bottleneck generations and only breeds the sample from explicit parents.\n"
+      "Kept as in full simulation: the sampling of the final individuals from few parents (hetx, mnehet).\n"
+      "Approximated: allele frequencies follow drift of a pool of 4 * Nb genes (mnals, m, lnbeta, mhomo, varhomo, skhomo, kurhomo);\n"
+      "iis only keeps the linkage disequilibrium built in the last generation. Check accepted regions with full simulation.");
+  }
+
   if(!parseExamplePop()){
     filterMonomorphicLoci();
     filterLowCoverageLoci();
     filterLowCoverageIndividuals();
     if(parseFillInAbsentData()) fillInMissingData();
+    allocateMissingMasks(&input_missing_masks, parseInputSamples(), parseNLoci());
+    packMissingMasks(&input_missing_masks, initial_indivs_data, parseNLoci());
     //printf("individuals = %d, loci = %d", parseInputSamples(), parseNLoci());
     //fflush(stdout);
     //exit(1);
@@ -133,73 +706,127 @@ int onesamp_engine(int argc, char **argv){
   }
 
 /*! \brief Allocates arrays to store sampling generations.
+ *
+ * The samples of one population are bred together, so they are allocated as
+ * a single block.
  */
-  final_indivs_data = (struct gtype_type **)malloc(parseIterations() * STRUCT_GTYPE_STAR_SIZE);
-  for(i = 0; i < parseIterations(); i++) {
-    final_indivs_data[i]=(struct gtype_type *)malloc(parseInputSamples() * STRUCT_GTYPE_SIZE);
+  final_indivs_data = (struct gtype_type **)malloc(num_slots * STRUCT_GTYPE_STAR_SIZE);
+  for(i = 0; i < num_slots; i++) {
+    if(i % num_samples == 0) final_indivs_data[i] = (struct gtype_type *)malloc(num_samples * parseInputSamples() * STRUCT_GTYPE_SIZE);
+    else final_indivs_data[i] = final_indivs_data[i - 1] + parseInputSamples();
     for(j = 0; j < parseInputSamples(); j++){
-      final_indivs_data[i][j].pgtype = (ALLELE_TYPE *)malloc(extraProportionOfBufferLoci * parseNLoci() * sizeof(ALLELE_TYPE));
-      final_indivs_data[i][j].mgtype = (ALLELE_TYPE *)malloc(extraProportionOfBufferLoci * parseNLoci() * sizeof(ALLELE_TYPE));
+      final_indivs_data[i][j].pgtype = (ALLELE_TYPE *)malloc(bufferLoci() * sizeof(ALLELE_TYPE));
+      final_indivs_data[i][j].mgtype = (ALLELE_TYPE *)malloc(bufferLoci() * sizeof(ALLELE_TYPE));
     }
   }
 
   // Simulate intermediate bottleneck generations
   // Make several data sets (parseIterations() of them) of final generations.
-  if(!parseRawSample()) for(i = 0; i < parseIterations(); i++){
-    // If the flag is set, make up a sample data set to complete an example.
-    // Generate a simulated case of initial conditions
-    #include "../engine/refactor_coalescent_engine.txt"
-
-    current = 0;
-    next = 1;
-
-    // Simulate bottleneck generations from random mating
-    for(j = 0; j < parseBottleneckLength(i); j++){
-      assort(parseBottleneck(i), females[next], females[current], males[current], parseBottleneck(i), i, extraProportionOfBufferLoci * parseNLoci());
-      assort(parseBottleneck(i), males[next], females[current], males[current], parseBottleneck(i), i, extraProportionOfBufferLoci * parseNLoci());
-      temp = current;
-      current = next;
-      next = temp;
-    }
-
-    // Then, generate a set of genotypes for final generation
-    assort(final_indivs_count, final_indivs_data[i], females[current], males[current], parseBottleneck(i), i, extraProportionOfBufferLoci * parseNLoci());
-
-    // Remove monomorphic loci if possible by replacing them with the extra loci
-    int extraLociIndex = parseNLoci();
-    for(j = 0; j < parseNLoci(); j++){
-      int tempGene1;
-      int tempGene2;
-      if(variantsOfFinalLocus(i, j) == 2) continue;
-      while(extraLociIndex < extraProportionOfBufferLoci * parseNLoci() && variantsOfFinalLocus(i, extraLociIndex) < 2){
-        extraLociIndex++;
-      }
-      if(!(extraLociIndex < extraProportionOfBufferLoci * parseNLoci())) break;
-      for(k = 0; k < parseInputSamples(); k++){
-        loadFinalGenotype(i, k, extraLociIndex, &tempGene1, &tempGene2);
-        storeFinalGenotype(i, k, j, &tempGene1, &tempGene2);
+  // Each iteration is simulated and summarized by a single thread; iterations
+  // vary widely in cost, so they are handed out dynamically.
+  if(parseEstimateCost()){
+    estimateCost(num_threads, num_slots, numberOfAlleles, doubleData, gType, gcount);
+  } else if(parseReplayIteration() >= 0){
+    replayIteration(parseReplayIteration(), num_slots, numberOfAlleles, doubleData, gType, gcount);
+  } else if(!parseRawSample()){
+    // Streamed iterations are handed out a block at a time; the block ends
+    // early once the time budget is spent.
+    int simulated = 0;
+    double start = omp_get_wtime();
+    GFSR_STYPE *seeds = (GFSR_STYPE *)malloc(num_threads * P() * sizeof(GFSR_STYPE));
+    splitRandomState(num_threads, seeds);
+    if(parseStreaming() && parseExamplePop()) writeOutputHeader();
+    #pragma omp parallel num_threads(num_threads) private(i, j)
+    {
+      // Allocate arrays to store intermediate generations.
+      struct gtype_type *females[2], *males[2];
+      struct pedigree ped;
+      struct founder_table founders;
+      struct packed_buffers packed;
+      allocateGenerationBuffers(females, males, parseBottleneckMax(), bufferLoci());
+      allocatePedigree(&ped, parseBottleneckLengthMax(), parseBottleneckMax(), parseSamplesPerPopulation() * parseInputSamples());
+      allocateFounderTable(&founders);
+      if(parsePackedSNPs()) allocatePackedBuffers(&packed, parseBottleneckMax(), parseSamplesPerPopulation() * parseInputSamples(), bufferLoci());
+      loadThreadRandomState(omp_get_thread_num(), seeds);
+
+      if(parseStreaming()){
+        // Rows come out in iteration order; a thread prints its iteration
+        // before taking the next one, which frees its slot.
+        int slot = omp_get_thread_num() * num_samples;
+        int first;
+        int last;
+        for(first = 0; first < parseIterations(); first = last){
+          // One thread ends the block and every thread gets its own copy, so
+          // none reads the end of the next block by mistake
+          #pragma omp single copyprivate(last)
+          {
+            last = parseIterations();
+            if(parseTimeBudget() >= 0){
+              last = timeBudgetSpent() ? first : first + SCHEDULE_BLOCK_ITERATIONS < parseIterations() ? first + SCHEDULE_BLOCK_ITERATIONS : parseIterations();
+              extendParameterSchedule(last);
+            }
+          }
+          if(last == first) break;
+          #pragma omp for schedule(dynamic, 1) ordered
+          for(i = first; i < last; i++){
+            // An iteration started before the deadline is finished and printed
+            int simulate = !timeBudgetSpent();
+            if(simulate){
+              simulateIteration(i, slot, females, males, &ped, &founders, parsePackedSNPs() ? &packed : NULL, locus_threads);
+              if(!parseExamplePop()) for(j = 0; j < num_samples; j++) computeIterationStatistics(i, slot + j, num_slots, numberOfAlleles, doubleData, gType, gcount, locus_threads);
+            }
+            #pragma omp ordered
+            if(simulate){
+              for(j = 0; j < num_samples; j++){
+                if(parseExamplePop()) writeOutputSample(final_indivs_data[slot + j], parseInputSamples());
+                else printIterationStatistics(i, slot + j, num_slots, doubleData);
+              }
+              fflush(stdout);
+              simulated++;
+            }
+          }
+        }
+      } else {
+        #pragma omp for schedule(dynamic, 1)
+        for(i = 0; i < parseIterations(); i++){
+          simulateIteration(i, i * num_samples, females, males, &ped, &founders, parsePackedSNPs() ? &packed : NULL, locus_threads);
+          if(parseExamplePop()) continue;
+          for(j = 0; j < num_samples; j++){
+            if(parseRejectRadius() >= 0) computeSummaryStatistics(i, i * num_samples + j, num_slots, numberOfAlleles, doubleData, gType, gcount);
+            else computeIterationStatistics(i, i * num_samples + j, num_slots, numberOfAlleles, doubleData, gType, gcount, locus_threads);
+          }
+        }
       }
-      extraLociIndex++;
-    }
 
-    // Add in missing data in coalescent population to mimic input population.
-    //double missingDataProbability = getProportionMissingData();
+      // Deallocate intermediate genotype arrays
+      deallocateGenerationBuffers(females, males, parseBottleneckMax());
+      deallocatePedigree(&ped);
+      deallocateFounderTable(&founders);
+      if(parsePackedSNPs()) deallocatePackedBuffers(&packed, parseBottleneckMax(), parseSamplesPerPopulation() * parseInputSamples());
+    }
+    free(seeds);
+    if(parseTimeBudget() >= 0){
+      double elapsed = omp_get_wtime() - start;
+      fprintf(stderr, "Simulated %d iterations, %d rows in %f s: %f rows/s\n", simulated, simulated * num_samples, elapsed, simulated * num_samples / elapsed);
+    }
 
-    if(!parseExamplePop()){
-      for(k = 0; k < parseInputSamples(); k++){
-        int maskFromInputSample = disrand(0, parseInputSamples() - 1);
-        for(j = 0; j < parseNLoci(); j++){
-          int mother;
-          int father;
-          loadInitialGenotype(maskFromInputSample, j, &father, &mother);
-          if(father == 0) final_indivs_data[i][k].pgtype[j] = 0;
-          if(mother == 0) final_indivs_data[i][k].mgtype[j] = 0;
-        }
+    // With --reject, iis is only computed for samples the statistics known so
+    // far leave within the radius; the others are logged and not printed.
+    if(parseRejectRadius() >= 0){
+      double *distances = (double *)malloc(num_slots * sizeof(double));
+      rejected = (unsigned char *)calloc(num_slots, sizeof(unsigned char));
+      partialDistances(num_slots, doubleData, parseRejectTarget(), distances);
+      for(i = 0; i < num_slots; i++){
+        if(distances[i] <= parseRejectRadius()) continue;
+        rejected[i] = TRUE;
+        fprintf(stderr, "Rejected iteration %d, sample %d: distance %f before iis\n", i / num_samples, i % num_samples, distances[i]);
       }
+      #pragma omp parallel for num_threads(num_threads) schedule(dynamic, 1)
+      for(i = 0; i < num_slots; i++){
+        if(!rejected[i]) computeLinkageStatistic(i, num_slots, parseNLoci(), numberOfAlleles, doubleData, gType, gcount, locus_threads);
+      }
+      free(distances);
     }
-
-    //writeoutput(final_indivs_data, final_indivs_count);
-
   } else { // We are using a raw sample
     // Copy SNPs over to final generation unchanged if we're computing
     // stats without simulating populations
@@ -210,76 +837,38 @@ int onesamp_engine(int argc, char **argv){
         final_indivs_data[0][i].mgtype[j] = initial_indivs_data[i].mgtype[j];
       }
     }
+    computeIterationStatistics(0, 0, num_slots, numberOfAlleles, doubleData, gType, gcount, parseThreads());
+    if(parseStreaming()) printIterationStatistics(0, 0, num_slots, doubleData);
   }
 
-  // Deallocate intermediate genotype arrays
-  for(i = 0; i < 2; i++){
-    for(j = 0; j < parseBottleneckMax(); j++){
-      free(females[i][j].pgtype);
-      free(males[i][j].pgtype);
-      free(females[i][j].mgtype);
-      free(males[i][j].mgtype);
+  // Streamed iterations have been printed already
+  if(!parseStreaming() && !parseEstimateCost() && parseReplayIteration() < 0){
+    if(parseExamplePop()){
+      // Dump population
+      writeOutputHeader();
+      for(i = 0; i < num_slots; i++){
+        writeOutputSample(final_indivs_data[i], parseInputSamples());
+      }
+    } else {
+      for(i = 0; i < num_slots; i++){
+        if(rejected == NULL || !rejected[i]) printIterationStatistics(i / num_samples, i, num_slots, doubleData);
+      }
     }
-    free(females[i]);
-    free(males[i]);
   }
 
-  if(parseExamplePop()){
-    // Dump population
-    writeoutput(final_indivs_data, parseInputSamples());
-  } else {
-    // Compute statistics
-
-    //writeoutput(final_indivs_data, parseInputSamples());
-
-    // Statistic 6: mnals
-    // Summarize information about alleles
-    counts(numberOfAllelesPtr, final_indivs_data, mnals, gType, gcountPtr);
-
-    // Statistic 1: m
-    // Only do next call if we're not using SNPs
-    // Calculate range, m, change in frequency of alleles 
-    sortM(numberOfAlleles, parseIterations(), m, gType, gcountPtr);
-
-    // Statistic 3: lnbeta
-    // Only do next call if we're not using SNPs
-    // Calculate beta statistic
-    beta(numberOfAlleles, parseIterations(), lnbeta, gType, gcountPtr);
-
-    // Statistics 4 and 5: hetx, mnehet
-    // Calculate the excess heterozygosity
-    hetexcess(numberOfAlleles, parseIterations(), final_indivs_data, hetx, mnehet, gType, gcountPtr);
-
-    // Statistics 7 and 8 (and 9 and 10): mhomo, varhomo, skhomo, kurhomo
-    // Calculate mean, variance, skew, and kurtosis of heterozygosity
-    multih(parseIterations(), final_indivs_data, mhomo, varhomo, skhomo, kurhomo, gType);
-
-    // Statistic 2: iis
-    // Calculate Burrows Weir stat from Vitalis and Couvet
-    twolocusiis(numberOfAlleles, parseIterations(), final_indivs_data, iis, gType, gcountPtr);
-
-    // Statistic 0: ne
-    // Calculate Ne
-    for(i = 0; i < parseIterations(); i++){
-      ne[i] = parseRawSample() ? -1 : (2*parseBottleneck(i)+(double)(1.0/(2*parseBottleneck(i)))+0.5);
-    }
-
-    for(i = 0; i < parseIterations(); i++){
-      printf("%f %f %f %f %f %f %f %f %f\n", ne[i], iis[i], hetx[i], mnehet[i], mnals[i], mhomo[i], varhomo[i], m[i], lnbeta[i]);
-    }
-
-  }
+  if(!parseExamplePop()) deallocateMissingMasks(&input_missing_masks);
+  free(rejected);
 
   // Deallocate structure 5
-  for(i = 0; i < parseIterations(); i++){
+  for(i = 0; i < num_slots; i++){
     for(j = 0; j < parseInputSamples(); j++){
       free(final_indivs_data[i][j].pgtype);
       free(final_indivs_data[i][j].mgtype);
     }
-    free(final_indivs_data[i]);
+    if(i % num_samples == 0) free(final_indivs_data[i]);
   }
   free(final_indivs_data);
-  deallocateOneSampMemory(initial_indivs_count, parseBottleneckMax(), final_indivs_count, parseIterations(), num_loci, numberOfAllelesPtr, doubleDataPtr, gTypePtr, gcountPtr);
+  deallocateOneSampMemory(initial_indivs_count, parseBottleneckMax(), final_indivs_count, num_slots, num_loci, numberOfAllelesPtr, doubleDataPtr, gTypePtr, gcountPtr);
   flushArguments();
 
   // Stop the random number table.
@@ -1,7 +1,62 @@
 #include "../macro/refactor_macro.h"
 #ifndef REFACTOR_ENGINE_H
 #define REFACTOR_ENGINE_H
+
+// Phases of an iteration timed by --estimate-cost
+
+/*! \def COST_PEDIGREE
+ *  \brief Drawing the pedigree and preparing the founder table.
+ */
+#define COST_PEDIGREE 0
+
+/*! \def COST_FOUNDERS
+ *  \brief Generating the founders (and drifting them, with -q).
+ */
+#define COST_FOUNDERS 1
+
+/*! \def COST_GENERATIONS
+ *  \brief Breeding the loci through the bottleneck generations to the sample.
+ */
+#define COST_GENERATIONS 2
+
+/*! \def COST_SAMPLE
+ *  \brief The rest of an iteration: finding replacement loci and adding missing data.
+ */
+#define COST_SAMPLE 3
+
+/*! \def COST_MNALS, COST_M, COST_LNBETA, COST_HETX, COST_MHOMO, COST_IIS
+ *  \brief Computing each statistic of a sample; hetx includes mnehet and mhomo the other moments.
+ */
+#define COST_MNALS 4
+#define COST_M 5
+#define COST_LNBETA 6
+#define COST_HETX 7
+#define COST_MHOMO 8
+#define COST_IIS 9
+
+/*! \def COST_PHASES
+ *  \brief Number of phases timed by --estimate-cost.
+ */
+#define COST_PHASES 10
+
+/*! \def ESTIMATE_ITERATIONS
+ *  \brief Number of iterations, spread over the schedule, simulated to estimate the cost of a run.
+ */
+#define ESTIMATE_ITERATIONS 8
+
+/*! \def ESTIMATE_LD_LOCI
+ *  \brief Number of loci whose pairs are timed for iis when estimating the cost of a run.
+ */
+#define ESTIMATE_LD_LOCI 64
+
+/*! \def ALLOCATION_OVERHEAD
+ *  \brief Bytes of bookkeeping assumed for each block allocated by malloc.
+ */
+#define ALLOCATION_OVERHEAD 16
+
 int onesamp_engine(int argc, char **argv);
+double estimatePeakMemory(int num_threads, int num_slots);
+void partialDistances(int num_slots, const double *doubleData, const double *target, double *distances);
 FILE *fetchInputPtr();
 FILE *fetchOutputPtr();
 #endif
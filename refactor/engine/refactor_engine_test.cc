@@ -1,4 +1,10 @@
 #include <gtest/gtest.h>
+#include <string>
+#include <algorithm>
+#include <sstream>
+#include <vector>
+#include <cstdio>
+#include <unistd.h>
 
 extern "C"{
 #include "../macro/refactor_macro.h"
@@ -6,3 +12,370 @@ extern "C"{
 
 TEST(engine, onesamp){
 }
+
+// Runs the engine with the given arguments and returns what it printed.
+static std::string captureEngine(int argc, char **argv){
+  testing::internal::CaptureStdout();
+  onesamp_engine(argc, argv);
+  return testing::internal::GetCapturedStdout();
+}
+
+// Counts the loci with fewer than two alleles in each sample of a dumped
+// population (-p), over all the samples of individuals individuals each.
+static int countMonomorphic(const std::string &dump, size_t individuals){
+  std::istringstream stream(dump);
+  std::string line;
+  std::vector<std::vector<std::string> > rows;
+  int monomorphic = 0;
+  while(std::getline(stream, line) && line != "Pop");
+  while(std::getline(stream, line)){
+    std::istringstream genotypes(line.substr(line.find(',') + 1));
+    std::vector<std::string> row;
+    std::string genotype;
+    while(genotypes >> genotype) row.push_back(genotype);
+    rows.push_back(row);
+  }
+  for(size_t first = 0; first + individuals <= rows.size(); first += individuals){
+    for(size_t l = 0; l < rows[first].size(); l++){
+      std::vector<std::string> alleles;
+      for(size_t k = first; k < first + individuals; k++){
+        alleles.push_back(rows[k][l].substr(0, 2));
+        alleles.push_back(rows[k][l].substr(2));
+      }
+      std::sort(alleles.begin(), alleles.end());
+      alleles.erase(std::unique(alleles.begin(), alleles.end()), alleles.end());
+      alleles.erase(std::remove(alleles.begin(), alleles.end(), std::string("00")), alleles.end());
+      if(alleles.size() < 2) monomorphic++;
+    }
+  }
+  return monomorphic;
+}
+
+// Splits output into its lines.
+static std::vector<std::string> splitLines(const std::string &output){
+  std::vector<std::string> lines;
+  std::istringstream stream(output);
+  std::string line;
+  while(std::getline(stream, line)) lines.push_back(line);
+  return lines;
+}
+
+// Runs the engine on a small simulated population, by default with
+// onesamp -rPHILOX2014 -t6 -b8,40 -d2,4 -u0.01 -v0.000048,0.0048 -s -l12 -i10 -o1 -f0.05 -p
+// and leaves the GFSR selected for the tests that follow. The observed sample,
+// if any, is fed to the engine as its input.
+class engine_run : public testing::Test {
+protected:
+  std::vector<std::string> args = {"onesamp", "-rPHILOX2014", "-t6", "-b8,40", "-d2,4", "-u0.01", "-v0.000048,0.0048", "-s", "-l12", "-i10", "-o1", "-f0.05", "-p"};
+  std::string observed;
+
+  // Observes a population simulated with the base arguments on one
+  // iteration, and switches to the statistics of the simulated samples (-e).
+  void observe(){
+    std::vector<std::string> base = args;
+    set({"-rPHILOX1", "-t1", "-b8", "-d2", "-v0.0048"});
+    observed = run();
+    args = base;
+    unset("-p");
+    set({"-e"});
+  }
+
+  // Sets each argument in place of the one of the same flag, or after the
+  // others if there is none.
+  void set(std::initializer_list<std::string> overrides){
+    for(const std::string &arg : overrides){
+      std::vector<std::string>::iterator same = find(arg);
+      if(same != args.end()) *same = arg;
+      else args.push_back(arg);
+    }
+  }
+
+  // Removes the argument of the same flag as arg, if any.
+  void unset(const std::string &arg){
+    std::vector<std::string>::iterator same = find(arg);
+    if(same != args.end()) args.erase(same);
+  }
+
+  // Returns the arguments as the engine takes them, valid until they change.
+  std::vector<char *> argv(){
+    std::vector<char *> pointers;
+    for(std::string &arg : args) pointers.push_back(&arg[0]);
+    return pointers;
+  }
+
+  // Runs the engine with the arguments and returns what it printed.
+  std::string run(){
+    std::vector<char *> pointers = argv();
+    FILE *input = tmpfile();
+    int saved_stdin = dup(fileno(stdin));
+    fputs(observed.c_str(), input);
+    rewind(input);
+    dup2(fileno(input), fileno(stdin));
+    clearerr(stdin);
+    std::string output = captureEngine(pointers.size(), pointers.data());
+    dup2(saved_stdin, fileno(stdin));
+    close(saved_stdin);
+    clearerr(stdin);
+    fclose(input);
+    return output;
+  }
+
+  void TearDown() override{
+    char name[] = "onesamp";
+    char reset[] = "-rRESET";
+    char syntax[] = "-x";
+    char *restore[] = {name, reset, syntax};
+    parseArguments(3, restore);
+    flushArguments();
+  }
+
+private:
+  // Short flags are the dash and letter, long ones run up to the '='.
+  static std::string flag(const std::string &arg){
+    return arg.compare(0, 2, "--") == 0 ? arg.substr(0, arg.find('=')) : arg.substr(0, 2);
+  }
+
+  std::vector<std::string>::iterator find(const std::string &arg){
+    return std::find_if(args.begin() + 1, args.end(), [&arg](const std::string &other){ return flag(other) == flag(arg); });
+  }
+};
+
+// onesamp -rPHILOX2014 -t6 -b8,40 -d2,4 -u0.01 -v0.000048,0.0048 -s -l12 -i10 -o1 -f0.05 -p -j<n>
+// With counter-based streams every iteration draws the same numbers whatever
+// thread simulates it, so the dumped populations match the serial run.
+TEST_F(engine_run, philox_threads_match_serial){
+  set({"-j1"});
+  std::string expected = run();
+  EXPECT_NE(expected.find("Pop"), std::string::npos);
+  EXPECT_EQ(expected, run());
+  set({"-j3"});
+  EXPECT_EQ(expected, run());
+  EXPECT_EQ(expected, run());
+}
+
+// onesamp -rPHILOX2014 -t6 -b8,40 -d2,4 -u0.01 -v0.000048,0.0048 -s -l12 -i10 -o1 -f0.05 -p -j<n> [-z]
+// Streamed iterations are printed in iteration order from one slot per
+// thread, so the output matches the run that keeps every sample.
+TEST_F(engine_run, streaming_matches_batch){
+  set({"-j1"});
+  std::string expected = run();
+  set({"-z"});
+  EXPECT_EQ(expected, run());
+  set({"-j3"});
+  EXPECT_EQ(expected, run());
+}
+
+// onesamp -rPHILOX77 -t<n> -b300 -d2 -u0.01 -v0.000048 -s -l5000 -i10 -o1 -f0.05 -p -j<n>
+// With fewer iterations than threads, the tiles of loci of an iteration are
+// shared among threads; each tile has its own stream, so the output does not
+// depend on the number of threads.
+TEST_F(engine_run, locus_threads_match_serial){
+  set({"-rPHILOX77", "-t1", "-b300", "-d2", "-u0.01", "-v0.000048", "-l5000", "-j1"});
+  std::string expected = run();
+  set({"-j4"});
+  EXPECT_EQ(expected, run());
+  set({"-t2", "-j1"});
+  expected = run();
+  set({"-j4"});
+  EXPECT_EQ(expected, run());
+}
+
+// onesamp -rPHILOX5 -t2 -b20 -d2 -u0.01 -v0.000048 -s -l12 -i10 -o1 -f0.05 -p -n<k>
+// A single sample per population is the default; with several, every
+// population gives that many samples, streamed or not.
+TEST_F(engine_run, samples_per_population){
+  set({"-rPHILOX5", "-t2", "-b20", "-d2", "-u0.01", "-v0.000048"});
+  std::string single = run();
+  set({"-n1"});
+  EXPECT_EQ(single, run());
+  set({"-n3"});
+  std::string expected = run();
+  set({"-z"});
+  EXPECT_EQ(expected, run());
+  // Header of 12 loci, then 2 populations of 3 samples of 10 individuals
+  EXPECT_EQ(std::count(expected.begin(), expected.end(), '\n'), 14 + 2 * 3 * 10);
+}
+
+// onesamp -rPHILOX5 -t2 -b20 -d<range> -u0.01 -v0.000048 -s -l12 -i10 -o1 -f0.05 -p -c
+// A trajectory is sampled after every duration in the range; with a single
+// duration that is the usual sample.
+TEST_F(engine_run, checkpoints_every_duration){
+  set({"-rPHILOX5", "-t2", "-b20", "-d4", "-u0.01", "-v0.000048"});
+  std::string single = run();
+  set({"-c"});
+  EXPECT_EQ(single, run());
+  set({"-d2,4"});
+  std::string expected = run();
+  set({"-z"});
+  EXPECT_EQ(expected, run());
+  // Header of 12 loci, then 2 populations sampled after 3 durations
+  EXPECT_EQ(std::count(expected.begin(), expected.end(), '\n'), 14 + 2 * 3 * 10);
+}
+
+// Distances to the observed statistics are measured in standard deviations
+// over the samples, leaving out statistics that do not vary and iis.
+TEST(engine, partial_distances){
+  const int num_slots = 4;
+  double doubleData[11 * num_slots];
+  double target[REJECT_TARGET_STATISTICS] = {-1, 100, 0, 0, 0, 0, 0, 0, 0};
+  double distances[num_slots];
+  int k, slot;
+
+  for(k = 0; k < 11 * num_slots; k++) doubleData[k] = 0;
+  // mnals is 1, 2, 3, 4 (standard deviation sqrt(5/3)), observed 2
+  for(slot = 0; slot < num_slots; slot++) doubleData[slot] = slot + 1;
+  target[4] = 2;
+  // iis varies, but is not known yet
+  for(slot = 0; slot < num_slots; slot++) doubleData[2 * num_slots + slot] = 10 * slot;
+  // hetx does not vary, and is left out although far from the observed
+  for(slot = 0; slot < num_slots; slot++) doubleData[4 * num_slots + slot] = 5;
+
+  partialDistances(num_slots, doubleData, target, distances);
+  for(slot = 0; slot < num_slots; slot++) EXPECT_NEAR(distances[slot], fabs(slot + 1 - 2) / sqrt(5.0 / 3), 1e-12);
+}
+
+// onesamp -rPHILOX5 -t<n> -b20 -d2 -u0.01 -v0.000048 -s -l12 -i10 -o1 -f0.05 -p --time-budget=<s>
+// Under a time budget iterations are streamed with the parameters of the same
+// iteration without one, and none is started once the budget is spent.
+TEST_F(engine_run, time_budget){
+  set({"-rPHILOX5", "-t3", "-b20", "-d2", "-u0.01", "-v0.000048", "-z"});
+  std::string expected = run();
+  unset("-z");
+  set({"--time-budget=1000"});
+  EXPECT_EQ(expected, run());
+  // Only the header of 12 loci is left
+  set({"--time-budget=0"});
+  std::string none = run();
+  EXPECT_EQ(std::count(none.begin(), none.end(), '\n'), 14);
+}
+
+// onesamp -rPHILOX2014 -t6 -b8,40 -d2,4 -u0.01 -v0.000048,0.0048 -s -l12 -i10 -o1 -f0.05 -p --replay-iteration=4
+// A replayed iteration dumps the same population as in the full run, after a
+// line of its parameters.
+TEST_F(engine_run, replay_iteration){
+  // Header of 12 loci, then 10 individuals per iteration
+  const size_t header_lines = 14;
+  const size_t sample_lines = 10;
+
+  std::string full = run();
+  set({"--replay-iteration=4"});
+  std::string replay = run();
+  EXPECT_EQ(replay.find("Replay of iteration 4: bottleneck "), 0u);
+  replay = replay.substr(replay.find('\n') + 1);
+  std::vector<std::string> full_lines, replay_lines;
+  std::istringstream full_stream(full), replay_stream(replay);
+  std::string line;
+  while(std::getline(full_stream, line)) full_lines.push_back(line);
+  while(std::getline(replay_stream, line)) replay_lines.push_back(line);
+  ASSERT_EQ(full_lines.size(), header_lines + 6 * sample_lines);
+  ASSERT_EQ(replay_lines.size(), header_lines + sample_lines);
+  for(size_t k = 0; k < header_lines; k++) EXPECT_EQ(replay_lines[k], full_lines[k]);
+  for(size_t k = 0; k < sample_lines; k++) EXPECT_EQ(replay_lines[header_lines + k], full_lines[header_lines + 4 * sample_lines + k]);
+}
+
+// onesamp -rPHILOX5 -t20 -b20 -d2 -u0.01 -v0.000048 -s -l12 -i10 -o1 -f0.05 -p --estimate-cost
+// The estimate replaces the populations with one line per simulation phase and
+// the totals, and the modelled memory grows with the samples kept at once.
+TEST_F(engine_run, estimate_cost){
+  set({"-rPHILOX5", "-t20", "-b20", "-d2", "-u0.01", "-v0.000048", "--estimate-cost"});
+
+  std::string estimate = run();
+  EXPECT_EQ(estimate.find("Estimated cost of 20 iterations, from 8 of them"), 0u);
+  EXPECT_NE(estimate.find("bottleneck generations"), std::string::npos);
+  EXPECT_NE(estimate.find("peak memory"), std::string::npos);
+  EXPECT_EQ(estimate.find("mnals"), std::string::npos);
+  EXPECT_EQ(std::count(estimate.begin(), estimate.end(), '\n'), 9);
+  std::vector<char *> pointers = argv();
+  parseArguments(pointers.size(), pointers.data());
+  EXPECT_LT(estimatePeakMemory(1, 1), estimatePeakMemory(1, 20));
+  EXPECT_LT(estimatePeakMemory(1, 20), estimatePeakMemory(2, 20));
+  flushArguments();
+}
+
+// onesamp -rPHILOX7 -t20 -b20 -d4 -u0 -v0.1 -s -l20 -i10 -o1 -f0.05 -p [-k]
+// Packed loci get as many replacements for monomorphic loci as unpacked ones,
+// however few loci are requested, so both runs end up with none left.
+TEST_F(engine_run, packed_replaces_monomorphic){
+  set({"-rPHILOX7", "-t20", "-b20", "-d4", "-u0", "-v0.1", "-l20"});
+
+  std::string unpacked = run();
+  set({"-k"});
+  std::string packed = run();
+  ASSERT_NE(packed.find("Pop"), std::string::npos);
+  EXPECT_EQ(countMonomorphic(unpacked, 20), 0);
+  EXPECT_EQ(countMonomorphic(packed, 20), 0);
+}
+
+// onesamp -rPHILOX2014 -t6 -b8,40 -d2,4 -u0.01 -v0.000048,0.0048 -s -l12 -i10 -o1 -f0.05 -e --reject=3.3,<file>
+// Samples further than the radius from the observed statistics (-w) lose
+// their rows, and the rows kept are those of the run without --reject.
+TEST_F(engine_run, reject_distant_samples){
+  char path[] = "/tmp/onesamp_rejectXXXXXX";
+  int target = mkstemp(path);
+  ASSERT_NE(target, -1);
+  observe();
+  unset("-e");
+  set({"-w"});
+  std::string row = run();
+  ASSERT_EQ(write(target, row.c_str(), row.size()), (ssize_t) row.size());
+  close(target);
+  unset("-w");
+  set({"-e"});
+
+  std::vector<std::string> all = splitLines(run());
+  set({std::string("--reject=3.3,") + path});
+  std::vector<std::string> kept = splitLines(run());
+  unlink(path);
+  // Iterations 0, 4 and 5 are rejected
+  ASSERT_EQ(all.size(), 6u);
+  ASSERT_EQ(kept.size(), 3u);
+  for(size_t k = 0; k < kept.size(); k++) EXPECT_EQ(kept[k], all[1 + k]);
+}
+
+// onesamp -rPHILOX2014 -t6 -b8,40 -d2,4 -u0.01 -v0.000048,0.0048 -s -l12 -i10 -o1 -f0.05 -e --replay-iteration=4
+// A replayed iteration ends with the same row of statistics as in the full
+// run.
+TEST_F(engine_run, replay_iteration_statistics){
+  observe();
+  std::vector<std::string> full = splitLines(run());
+  set({"--replay-iteration=4"});
+  std::vector<std::string> replay = splitLines(run());
+  ASSERT_EQ(full.size(), 6u);
+  ASSERT_GE(replay.size(), 2u);
+  EXPECT_EQ(replay[0].find("Replay of iteration 4: bottleneck "), 0u);
+  EXPECT_EQ(replay[replay.size() - 2], "Auto-generated statistics output.");
+  EXPECT_EQ(replay.back(), full[4]);
+}
+
+// onesamp -rC -m2,2,2,2,2,2,2,2,2,2,2,2 -l12 -i10 -b6 -u0.5 -o1 -g
+// A single generation bred from microsatellites mutates them by motif
+// lengths, so every allele keeps its three digits.
+TEST_F(engine_run, single_generation_microsatellites){
+  args = {"onesamp", "-rC", "-m2,2,2,2,2,2,2,2,2,2,2,2", "-l12", "-i10", "-b6", "-u0.5", "-o1", "-g"};
+  observed = "Auto-generated genotype output.\n";
+  for(int l = 1; l <= 12; l++) observed += std::to_string(l) + "\n";
+  observed += "Pop\n";
+  for(int k = 1; k <= 10; k++){
+    observed += std::to_string(k) + " ,";
+    for(int l = 0; l < 12; l++) observed += " " + std::to_string(192 + 2 * ((k + l) % 3)) + std::to_string(192 + 2 * ((k * l) % 3));
+    observed += "\n";
+  }
+
+  std::vector<std::string> lines = splitLines(run());
+  std::vector<std::string>::iterator pop = std::find(lines.begin(), lines.end(), "Pop");
+  ASSERT_NE(pop, lines.end());
+  // The 6 individuals of the generation
+  ASSERT_EQ(lines.end() - pop - 1, 6);
+  for(++pop; pop != lines.end(); ++pop){
+    std::istringstream genotypes(pop->substr(pop->find(',') + 1));
+    std::string genotype;
+    int count = 0;
+    while(genotypes >> genotype){
+      ASSERT_EQ(genotype.size(), 6u) << *pop;
+      EXPECT_GE(std::stoi(genotype.substr(0, 3)), 100) << *pop;
+      EXPECT_GE(std::stoi(genotype.substr(3)), 100) << *pop;
+      count++;
+    }
+    EXPECT_EQ(count, 12);
+  }
+}
@@ -14,42 +14,203 @@ GFSR_STYPE rand_table[P()];
  */
 int jindic;
 
+/*! \var unsigned int crand_seed
+ *  \brief State of the C library generator used when C_RANDOM_FLAG is set.
+ */
+unsigned int crand_seed;
+
+/*! \var struct random_buffer current_random_buffer
+ *  \brief Words and bits handed out by randomWord() and randomBit().
+ */
+struct random_buffer current_random_buffer = {{0}, RANDOM_BUFFER_WORDS, 0, 0};
+
 /*! \var const char filename[]
  *  \brief File name of GFSR table.
  */
 const char filenameGFSR[] = "INITFILE";
 
-/*! \def writeoutput(struct gtype_type **samp_data)
- *  \brief displays genotype data from final generation
+/*! \brief Refills the random word buffer and returns its first word.
+ *
+ * Counter-based streams are filled block-parallel. The C library generator
+ * only gives 31 bits per call, so two calls are combined into each word.
  */
-void writeoutput(struct gtype_type **samp_data, int final_indivs_count)
+unsigned int refillRandomWords(){
+  int k;
+  if(STREAM_RANDOM_FLAG){
+    fillRandomStreamWords(&current_random_stream, current_random_buffer.words, RANDOM_BUFFER_WORDS);
+  } else if(C_RANDOM_FLAG){
+    for(k = 0; k < RANDOM_BUFFER_WORDS; k++)
+      current_random_buffer.words[k] = ((unsigned int) rand_r(&crand_seed) << 16) ^ (unsigned int) rand_r(&crand_seed);
+  } else {
+    for(k = 0; k < RANDOM_BUFFER_WORDS; k++)
+      current_random_buffer.words[k] = (unsigned int) intrand();
+  }
+  current_random_buffer.position = 1;
+  return current_random_buffer.words[0];
+}
+
+/*! \brief Refills the random bit reservoir with 64 bits and returns the first.
+ */
+int refillRandomBits(){
+  current_random_buffer.bits = randomWord64();
+  current_random_buffer.bits_left = 63;
+  return (int) (current_random_buffer.bits >> 63);
+}
+
+/*! \brief Returns a random integer in [0, n) without division in the common case.
+ *
+ * Scales a random word by n with a 64-bit multiply and keeps the high half
+ * (Lemire 2019, Fast Random Integer Generation in an Interval). The rare
+ * words that would bias the result are rejected, so it is exactly uniform.
+ */
+unsigned int randomBounded(unsigned int n){
+  unsigned long long product = (unsigned long long) randomWord() * n;
+  unsigned int low = (unsigned int) product;
+  if(low < n){
+    unsigned int threshold = -n % n;
+    while(low < threshold){
+      product = (unsigned long long) randomWord() * n;
+      low = (unsigned int) product;
+    }
+  }
+  return (unsigned int) (product >> 32);
+}
+
+/*! \brief Returns a random 64-bit word made of two buffered words.
+ */
+unsigned long long randomWord64(){
+  unsigned long long high = randomWord();
+  return (high << 32) | randomWord();
+}
+
+/*! \brief Returns the number of failed trials before the next success.
+ *
+ * Draws from the geometric distribution of Bernoulli trials with success
+ * probability p, given logFailure = log(1 - p), by inverting its distribution
+ * function. With p = 0 there is never a success, and a value larger than any
+ * count of trials is returned.
+ */
+long long randomGeometricSkip(double logFailure){
+  double skip;
+  if(logFailure == 0) return LLONG_MAX / 2;
+  skip = floor(log(1.0 - randomUniform()) / logFailure);
+  return skip < (double) (LLONG_MAX / 2) ? (long long) skip : LLONG_MAX / 2;
+}
+
+/*! \brief Returns the number of successes in n Bernoulli trials with success probability p.
+ *
+ * Counts successes by geometric skips between them while fewer than 30 are
+ * expected, which is exact. Beyond that, the normal approximation to the
+ * binomial is drawn (Box-Muller), rounded and clamped to [0, n]. The smaller
+ * of p and 1 - p is drawn, so the cost stays bounded by the rarer outcome.
+ */
+int randomBinomial(int n, double p){
+  int flipped = p > 0.5;
+  double q = flipped ? 1.0 - p : p;
+  long long successes = 0;
+  if(q <= 0 || n <= 0) return flipped ? n : 0;
+  if(n * q < 30){
+    double logFailure = log1p(-q);
+    long long trial;
+    for(trial = randomGeometricSkip(logFailure); trial < n; trial += 1 + randomGeometricSkip(logFailure)) successes++;
+  } else {
+    double radius = sqrt(-2.0 * log(1.0 - randomUniform()));
+    double normal = radius * cos(2.0 * M_PI * randomUniform());
+    successes = (long long) floor(n * q + sqrt(n * q * (1.0 - q)) * normal + 0.5);
+    if(successes < 0) successes = 0;
+    if(successes > n) successes = n;
+  }
+  return (int) (flipped ? n - successes : successes);
+}
+
+/*! \brief Scrambles a word drawn from the master generator (MurmurHash3 finalizer).
+ *
+ * The GFSR register holds its last P() outputs, so seeding a thread with P()
+ * raw consecutive outputs would replay the master sequence on that thread.
+ * The nonlinear mix breaks that relationship.
+ */
+unsigned int mixRandomSeed(unsigned int value){
+  value ^= value >> 16;
+  value *= 0x85ebca6bU;
+  value ^= value >> 13;
+  value *= 0xc2b2ae35U;
+  value ^= value >> 16;
+  return value;
+}
+
+/*! \brief Draws seeds for worker threads from the master random number state.
+ *
+ * Fills P() seed words for each of threads 1 .. num_threads - 1. Thread 0 is
+ * the master thread and continues with its own state.
+ */
+void splitRandomState(int num_threads, GFSR_STYPE *seeds){
+  int thread, k;
+  for(thread = 1; thread < num_threads; thread++)
+    for(k = 0; k < P(); k++)
+      seeds[thread * P() + k] = (GFSR_STYPE) mixRandomSeed((unsigned int) intrand() + thread * P() + k);
+}
+
+/*! \brief Loads the random number state of a worker thread from its seeds.
+ */
+void loadThreadRandomState(int thread, const GFSR_STYPE *seeds){
+  int k;
+  if(thread == 0) return;
+  for(k = 0; k < P(); k++) rand_table[k] = seeds[thread * P() + k];
+  jindic = 0;
+  crand_seed = (unsigned int) seeds[thread * P()];
+  discardRandomBuffer();
+  if(!C_RANDOM_FLAG && !STREAM_RANDOM_FLAG) for(k = 0; k < GFSR_RESET_PERIOD(); k++) intrand();
+}
+
+/*! \def writeOutputHeader()
+ *  \brief displays the header of the genotype data from final generation
+ */
+void writeOutputHeader()
 {
   int num_loci = parseNLoci();
-  int num_samples = parseIterations();
-
-  int j,k,i;
+  int j;
   printf("Auto-generated genotype output.\n");
     for (j = 0; j < num_loci;++j) {
       printf("%1d\n",j+1);
   }
   printf("Pop\n");
-  for(k = 0; k < num_samples; k++) {
-    for(j = 0; j < final_indivs_count; j++){
-      printf("%d , ", j+1);
-      for(i = 0; i < num_loci;++i){
-        printf("%02d%02d ", samp_data[k][j].mgtype[i], samp_data[k][j].pgtype[i]);
-      }
-      printf("\n");
+}
+
+/*! \def writeOutputSample(struct gtype_type *sample, int final_indivs_count)
+ *  \brief displays genotype data of one sample from final generation
+ */
+void writeOutputSample(struct gtype_type *sample, int final_indivs_count)
+{
+  int num_loci = parseNLoci();
+  int j,i;
+  for(j = 0; j < final_indivs_count; j++){
+    printf("%d , ", j+1);
+    for(i = 0; i < num_loci;++i){
+      printf("%02d%02d ", sample[j].mgtype[i], sample[j].pgtype[i]);
     }
+    printf("\n");
   }
 }
 
-/*! \def numberOfAllelesDump(int **numberOfAlleles)
- *  \brief displays count of kinds of alleles at each locus in final generation
+/*! \def writeoutput(struct gtype_type **samp_data)
+ *  \brief displays genotype data from final generation
  */
-void numberOfAllelesDump(int **numberOfAlleles){
-  int num_loci = parseNLoci();
+void writeoutput(struct gtype_type **samp_data, int final_indivs_count)
+{
   int num_samples = parseIterations();
+
+  int k;
+  writeOutputHeader();
+  for(k = 0; k < num_samples; k++) {
+    writeOutputSample(samp_data[k], final_indivs_count);
+  }
+}
+
+/*! \def numberOfAllelesDump(int **numberOfAlleles, int num_samples)
+ *  \brief displays count of kinds of alleles at each locus in the first num_samples samples
+ */
+void numberOfAllelesDump(int **numberOfAlleles, int num_samples){
+  int num_loci = parseNLoci();
   int k, i;
   printf("Auto-generated number of alleles output.\n");
   for(k = 0; k < num_samples; k++) {
@@ -60,12 +221,11 @@ void numberOfAllelesDump(int **numberOfAlleles){
   }
 }
 
-/*! \def TypeDump(int ***gType, int **numberOfAlleles)
- *  \brief displays genotypes of final generation
+/*! \def gTypeDump(int ***gType, int **numberOfAlleles, int num_samples)
+ *  \brief displays alleles found at each locus in the first num_samples samples
  */
-void gTypeDump(int ***gType, int **numberOfAlleles){
+void gTypeDump(int ***gType, int **numberOfAlleles, int num_samples){
   int num_loci = parseNLoci();
-  int num_samples = parseIterations();
   int k, i, j;
   printf("Auto-generated gType output.\n");
   for(k = 0; k < num_samples; k++) {
@@ -80,12 +240,11 @@ void gTypeDump(int ***gType, int **numberOfAlleles){
   } 
 }
 
-/*! \def gcountDump(int ***gCount, int **numberOfAlleles)
- *  \brief displays counts of alleles in final generation
+/*! \def gcountDump(int ***gCount, int **numberOfAlleles, int num_samples)
+ *  \brief displays counts of alleles in the first num_samples samples
  */
-void gcountDump(int ***gCount, int **numberOfAlleles){
+void gcountDump(int ***gCount, int **numberOfAlleles, int num_samples){
   int num_loci = parseNLoci();
-  int num_samples = parseIterations();
   int k, i, j;
   printf("Auto-generated gcount output.\n");
   for(k = 0; k < num_samples; k++) {
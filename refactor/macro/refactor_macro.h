@@ -13,6 +13,7 @@
 #include <assert.h>
 #include <time.h>
 #include <stdlib.h>
+#include "../random/refactor_random.h"
 
 /* \def MAX_NO_ALLELES
  * \brief Defines maximum number of alleles.
@@ -57,9 +58,16 @@ typedef struct gtype_type gtype_type;
 #define FALSE (0 == 1)
 
 /*! \def C_RANDOM_FLAG
- *  \brief If true, use C random numbers. If false, use GFSR random numbers.
+ *  \brief If true, use C random numbers.
  */
-#define C_RANDOM_FLAG (parseRFlag())
+#define C_RANDOM_FLAG (parseRFlag() == 1)
+
+/*! \def STREAM_RANDOM_FLAG
+ *  \brief If true, use counter-based random streams (one per iteration).
+ *
+ * If neither this nor C_RANDOM_FLAG is set, use GFSR random numbers.
+ */
+#define STREAM_RANDOM_FLAG (parseRFlag() == 2)
 
 /* \def ASCII_ZERO
  * \brief Value of zero in ASCII: used for character conversion in parsing.
@@ -67,9 +75,10 @@ typedef struct gtype_type gtype_type;
 #define ASCII_ZERO (48)
 
 /* \def extraProportionOfBufferLoci
- * \brief Create extra loci so that we can throw out monomorphic ones when they arise.
- * Larger values are more "safe", but will use more memory and will cause
- * the program to run more slowly.
+ * \brief Cap on the loci simulated per iteration, as a multiple of the loci requested.
+ * Extra loci are simulated only to replace monomorphic ones as they arise, up
+ * to this many loci in all. Larger values are more "safe", but will use more
+ * memory.
  */
 #define extraProportionOfBufferLoci 2
 
@@ -181,6 +190,13 @@ extern struct gtype_type *initial_indivs_data, **final_indivs_data;
 #define randomQuantizedIntervalSelection(min, max, step) \
   (step * disrand((int)(min/step),(int)(max/step)))
 
+/*! \def quantizedIntervalPoint(float min, float max, float step, double unit)
+ *  \brief Returns the step of an interval at which a point of [0, 1) falls,
+ *  each step taking an equal share.
+ */
+#define quantizedIntervalPoint(min, max, step, unit) \
+  (step * ((int)(min/step) + (int)((unit) * ((int)(max/step) - (int)(min/step) + 1))))
+
 /*! \def void resetgfsr()
  *  \brief Resets the pseudorandom GFSR to standard values.
  *
@@ -257,8 +273,14 @@ extern struct gtype_type *initial_indivs_data, **final_indivs_data;
 
 extern GFSR_STYPE rand_table[P()];
 extern int jindic;
+extern unsigned int crand_seed;
 extern const char filenameGFSR[];
 
+// Each thread that simulates iterations owns a private copy of the random
+// number state. The master thread's copy is the one read from and written to
+// the GFSR file, so single-threaded runs behave exactly as before.
+#pragma omp threadprivate(rand_table, jindic, crand_seed)
+
 // I copied explicitly the functionality of the original code, modifying some
 // aspects of how it is interpereted (which I believe is okay because it is
 // GPL), but in some cases modified the formatting or other internal aspects
@@ -287,10 +309,12 @@ extern const char filenameGFSR[];
 // BEGIN GPL v2 R code insertion
 
 /*! \def int intrand()
- *  \brief Generates random int if C_RANDOM_FLAG is set, else GFSR random int.
+ *  \brief Generates random int if C_RANDOM_FLAG is set, a word of the current
+ *  stream if STREAM_RANDOM_FLAG is set, else GFSR random int.
  */
 #define intrand() \
-  (C_RANDOM_FLAG ? rand() : \
+  (C_RANDOM_FLAG ? rand_r(&crand_seed) : \
+  STREAM_RANDOM_FLAG ? (int) nextRandomStreamWord(&current_random_stream) : \
   (++jindic, jindic %= (P()), \
   rand_table[jindic] \
     = rand_table[jindic]^rand_table[(jindic + (Q())) % (P())]))
@@ -304,7 +328,7 @@ extern const char filenameGFSR[];
 /*! \def float gfsr4()
  *  \brief Returns a random float in the range [0,1).
  */
-#define gfsr4() (C_RANDOM_FLAG ? ((float) rand()) / INT_MAX : (float)(( GFSR_STYPE_UNSIGNED ) intrand()) / \
+#define gfsr4() (C_RANDOM_FLAG ? ((float) rand_r(&crand_seed)) / INT_MAX : (float)(( GFSR_STYPE_UNSIGNED ) intrand()) / \
                    (GFSR_STYPE_UNSIGNED_MAX + 1.0))
 
 /*! \def void opengfsr()
@@ -327,7 +351,7 @@ extern const char filenameGFSR[];
 { \
   if(C_RANDOM_FLAG) \
   { \
-    srand(time(NULL)); \
+    crand_seed = time(NULL); \
   } \
   else \
   { \
@@ -358,7 +382,7 @@ extern const char filenameGFSR[];
  */
 #define closegfsr() \
 { \
-  if(!C_RANDOM_FLAG) \
+  if(!C_RANDOM_FLAG && !STREAM_RANDOM_FLAG) \
   { \
   int temp_macro_closegfsr_j; \
   FILE *temp_macro_closegfsr_rt = fopen(GFSR_INIT_NAME(),"w"); \
@@ -373,15 +397,91 @@ extern const char filenameGFSR[];
 
 // END R code insertion
 
+/*! \def void useRandomStream(iteration, substream)
+ *  \brief Makes intrand() read from the given stream of the run seed.
+ *
+ * Does nothing unless STREAM_RANDOM_FLAG is set, so the GFSR and C sequences
+ * are unchanged. Iterations are numbered from parseFirstIteration() (--shard);
+ * the setup stream is shared by every shard.
+ */
+#define useRandomStream(iteration, substream) \
+{ \
+  if(STREAM_RANDOM_FLAG) \
+  { \
+    seedRandomStream(&current_random_stream, parseRandomSeed(), (substream) == RANDOM_SUBSTREAM_SETUP ? (iteration) : parseFirstIteration() + (iteration), (substream)); \
+    discardRandomBuffer(); \
+  } \
+}
+
+// BUFFERED RANDOMIZATION
+//
+// The macros above draw one word per call. The ones below hand out words from
+// a buffer that is refilled RANDOM_BUFFER_WORDS at a time from the selected
+// source, and single bits from a 64-bit reservoir, which is much cheaper for
+// the inner loops of the simulation. They draw from the same source as
+// intrand(), but consume it differently, so they do not reproduce the
+// sequences of the unbuffered macros.
+
+/*! \def unsigned int randomWord()
+ *  \brief Returns a random 32-bit word from the buffer.
+ */
+#define randomWord() \
+  (current_random_buffer.position < RANDOM_BUFFER_WORDS ? \
+   current_random_buffer.words[current_random_buffer.position++] : \
+   refillRandomWords())
+
+/*! \def int randomBit()
+ *  \brief Returns a random bit from the 64-bit reservoir.
+ */
+#define randomBit() \
+  (current_random_buffer.bits_left ? \
+   (int) ((current_random_buffer.bits >> --current_random_buffer.bits_left) & 1) : \
+   refillRandomBits())
+
+/*! \def double randomUniform()
+ *  \brief Returns a random double in [0,1) with 32 bits of resolution.
+ */
+#define randomUniform() (randomWord() * (1.0 / 4294967296.0))
+
+/*! \def int randomWithProbability(double p)
+ *  \brief Returns 1 with probability p, else 0.
+ */
+#define randomWithProbability(p) (randomUniform() < (p))
+
+/*! \def void discardRandomBuffer()
+ *  \brief Empties the buffer so the next draws come straight from the source.
+ */
+#define discardRandomBuffer() \
+{ \
+  current_random_buffer.position = RANDOM_BUFFER_WORDS; \
+  current_random_buffer.bits_left = 0; \
+}
+
+extern struct random_buffer current_random_buffer;
+#pragma omp threadprivate(current_random_buffer)
+
 #include "../arguments/refactor_arguments.h"
 #include "../engine/refactor_engine.h"
 #include "../parser/refactor_parser.h"
 #include "../memory/refactor_memory.h"
 #include "../stats/refactor_stats.h"
-
+#include "../pedigree/refactor_pedigree.h"
+#include "../packed/refactor_packed.h"
+
+unsigned int refillRandomWords();
+int refillRandomBits();
+unsigned int randomBounded(unsigned int n);
+unsigned long long randomWord64();
+long long randomGeometricSkip(double logFailure);
+int randomBinomial(int n, double p);
+unsigned int mixRandomSeed(unsigned int value);
+void splitRandomState(int num_threads, GFSR_STYPE *seeds);
+void loadThreadRandomState(int thread, const GFSR_STYPE *seeds);
+void writeOutputHeader();
+void writeOutputSample(gtype_type *sample, int final_indivs_count);
 void writeoutput(gtype_type **samp_data, int final_indivs_count);
-void numberOfAllelesDump(int **numberOfAlleles);
-void gTypeDump(int ***gType, int **numberOfAlleles);
-void gcountDump(int ***gCount, int **numberOfAlleles);
+void numberOfAllelesDump(int **numberOfAlleles, int num_samples);
+void gTypeDump(int ***gType, int **numberOfAlleles, int num_samples);
+void gcountDump(int ***gCount, int **numberOfAlleles, int num_samples);
 
 #endif
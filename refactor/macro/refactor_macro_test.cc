@@ -99,3 +99,71 @@ TEST(macro, macro_gfsr_file_access){
   free(arg);
   free(argv);
 }
+
+// The buffered API draws whole words from the GFSR in order, and its bounded
+// integers and bits stay in range.
+TEST(macro, macro_random_buffer){
+  int i;
+  int ones = 0;
+
+  unsigned int words[RANDOM_BUFFER_WORDS + 1];
+  resetgfsr();
+  discardRandomBuffer();
+  for(i = 0; i <= RANDOM_BUFFER_WORDS; i++) words[i] = randomWord();
+  EXPECT_EQ(words[0], 1587561535U);
+  resetgfsr();
+  for(i = 0; i <= RANDOM_BUFFER_WORDS; i++) EXPECT_EQ(words[i], (unsigned int) intrand());
+
+  for(i = 0; i < 10000; i++){
+    EXPECT_LT(randomBounded(7), 7U);
+    EXPECT_LT(randomUniform(), 1.0);
+    ones += randomBit();
+  }
+  EXPECT_GT(ones, 4500);
+  EXPECT_LT(ones, 5500);
+  EXPECT_EQ(randomBounded(1), 0U);
+
+  resetgfsr();
+  discardRandomBuffer();
+}
+
+// Geometric skips have mean (1 - p) / p, and the edge cases p = 0 and p = 1
+// never and always succeed.
+TEST(macro, macro_geometric_skip){
+  int i;
+  double total = 0;
+  for(i = 0; i < 20000; i++) total += randomGeometricSkip(log1p(-0.1));
+  EXPECT_NEAR(total / 20000, 9.0, 0.3);
+  EXPECT_GT(randomGeometricSkip(log1p(-0.0)), 1000000000000LL);
+  EXPECT_EQ(randomGeometricSkip(log1p(-1.0)), 0LL);
+  resetgfsr();
+  discardRandomBuffer();
+}
+
+// Binomial draws have mean n * p and variance n * p * (1 - p), both when
+// successes are counted and when the normal approximation is used, and the
+// edge cases p = 0 and p = 1 are exact.
+TEST(macro, macro_binomial){
+  const int draws = 20000;
+  int i, k;
+  for(k = 0; k < 2; k++){
+    int n = k == 0 ? 40 : 4000;
+    double p = k == 0 ? 0.3 : 0.75;
+    double total = 0;
+    double squares = 0;
+    for(i = 0; i < draws; i++){
+      int x = randomBinomial(n, p);
+      EXPECT_GE(x, 0);
+      EXPECT_LE(x, n);
+      total += x;
+      squares += (double) x * x;
+    }
+    EXPECT_NEAR(total / draws, n * p, 0.02 * n * p);
+    EXPECT_NEAR(squares / draws - (total / draws) * (total / draws), n * p * (1 - p), 0.1 * n * p * (1 - p));
+  }
+  EXPECT_EQ(randomBinomial(100, 0.0), 0);
+  EXPECT_EQ(randomBinomial(100, 1.0), 100);
+  EXPECT_EQ(randomBinomial(0, 0.5), 0);
+  resetgfsr();
+  discardRandomBuffer();
+}
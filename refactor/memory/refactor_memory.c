@@ -114,6 +114,40 @@ void deallocateOneSampMemory(int initial_inidivs_count_allocation, int bottlenec
   free(*numberOfAllelesPtr);
 }
 
+/*! \brief Allocates the two alternating generations of a bottleneck population.
+ */
+void allocateGenerationBuffers(struct gtype_type *females[2], struct gtype_type *males[2], int bottleneck_indivs_count, int num_loci_allocation){
+  int i;
+  int j;
+  for(i = 0; i < 2; i++){
+    females[i] = (struct gtype_type *)malloc(bottleneck_indivs_count * STRUCT_GTYPE_SIZE);
+    males[i] = (struct gtype_type *)malloc(bottleneck_indivs_count * STRUCT_GTYPE_SIZE);
+    for(j = 0; j < bottleneck_indivs_count; j++){
+      females[i][j].pgtype = (ALLELE_TYPE *)malloc(num_loci_allocation * sizeof(ALLELE_TYPE));
+      males[i][j].pgtype = (ALLELE_TYPE *)malloc(num_loci_allocation * sizeof(ALLELE_TYPE));
+      females[i][j].mgtype = (ALLELE_TYPE *)malloc(num_loci_allocation * sizeof(ALLELE_TYPE));
+      males[i][j].mgtype = (ALLELE_TYPE *)malloc(num_loci_allocation * sizeof(ALLELE_TYPE));
+    }
+  }
+}
+
+/*! \brief Deallocates the two alternating generations of a bottleneck population.
+ */
+void deallocateGenerationBuffers(struct gtype_type *females[2], struct gtype_type *males[2], int bottleneck_indivs_count){
+  int i;
+  int j;
+  for(i = 0; i < 2; i++){
+    for(j = 0; j < bottleneck_indivs_count; j++){
+      free(females[i][j].pgtype);
+      free(males[i][j].pgtype);
+      free(females[i][j].mgtype);
+      free(males[i][j].mgtype);
+    }
+    free(females[i]);
+    free(males[i]);
+  }
+}
+
 /*! \brief Loads an initial genotype from memory.
  */
 void loadInitialGenotype(int individual, int index, int *genotype1, int *genotype2){
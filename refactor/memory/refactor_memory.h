@@ -5,6 +5,8 @@
 void allocateStructure1(int initial_indivs_count, int bottleneck_indivs_count, int final_indivs_count, int num_samples, int num_loci, int ***numberOfAllelesPtr, double **doubleDataPtr, int ****gTypePtr, int ****gcountPtr);
 void allocateOneSampMemory(int initial_indivs_count, int bottleneck_indivs_count, int final_indivs_count, int num_samples, int num_loci, int ***numberOfAllelesPtr, double **doubleDataPtr, int ****gTypePtr, int ****gcountPtr);
 void deallocateOneSampMemory(int initial_indivs_count, int bottleneck_indivs_count, int final_indivs_count, int num_samples, int num_loci, int ***numberOfAllelesPtr, double **doubleDataPtr, int ****gTypePtr, int ****gcountPtr);
+void allocateGenerationBuffers(struct gtype_type *females[2], struct gtype_type *males[2], int bottleneck_indivs_count, int num_loci_allocation);
+void deallocateGenerationBuffers(struct gtype_type *females[2], struct gtype_type *males[2], int bottleneck_indivs_count);
 void storeInitialGenotype(int individual, int index, int *genotype1, int *genotype2);
 void loadInitialGenotype(int individual, int index, int *genotype1, int *genotype2);
 void storeFinalGenotype(int sample, int individual, int index, const int *genotype1, const int *genotype2);
@@ -0,0 +1,618 @@
+/*! \file refactor_packed.c
+ *  \brief Bit-packed SNP generations for OneSamp.
+ *
+ * A simulated SNP locus only ever holds the two bases its founders were drawn
+ * with, so each allele fits in one bit. Packing 64 loci into a word lets
+ * assortPacked() build offspring haplotypes a word at a time, and shrinks the
+ * bottleneck generations 16 times compared to one ALLELE_TYPE per allele.
+ *
+ * The zygosity of a sample is kept the same way for the statistics that only
+ * ask whether the two alleles of a locus are equal or missing: one pass packs
+ * it, and they then count a word of loci at a time.
+ *
+ * For linkage disequilibrium the planes run the other way, over the
+ * individuals of one locus and allele, so that the genotypes of a pair of
+ * loci are tallied with a few ANDs and popcounts.
+ */
+
+#include "refactor_packed.h"
+
+/*! \brief Allocates the packed scratch generations and sample of one thread.
+ */
+void allocatePackedBuffers(struct packed_buffers *buffers, int bottleneck_indivs_count, int final_indivs_count, int num_loci_allocation){
+  int i, j;
+  buffers->num_words = packedWords(num_loci_allocation);
+  for(i = 0; i < 2; i++){
+    buffers->females[i] = (struct packed_gtype_type *)malloc(bottleneck_indivs_count * sizeof(struct packed_gtype_type));
+    buffers->males[i] = (struct packed_gtype_type *)malloc(bottleneck_indivs_count * sizeof(struct packed_gtype_type));
+    for(j = 0; j < bottleneck_indivs_count; j++){
+      buffers->females[i][j].pbits = (unsigned long long *)malloc(buffers->num_words * sizeof(unsigned long long));
+      buffers->females[i][j].mbits = (unsigned long long *)malloc(buffers->num_words * sizeof(unsigned long long));
+      buffers->males[i][j].pbits = (unsigned long long *)malloc(buffers->num_words * sizeof(unsigned long long));
+      buffers->males[i][j].mbits = (unsigned long long *)malloc(buffers->num_words * sizeof(unsigned long long));
+    }
+  }
+  buffers->sample = (struct packed_gtype_type *)malloc(final_indivs_count * sizeof(struct packed_gtype_type));
+  for(j = 0; j < final_indivs_count; j++){
+    buffers->sample[j].pbits = (unsigned long long *)malloc(buffers->num_words * sizeof(unsigned long long));
+    buffers->sample[j].mbits = (unsigned long long *)malloc(buffers->num_words * sizeof(unsigned long long));
+  }
+  buffers->reference = (ALLELE_TYPE *)malloc(num_loci_allocation * sizeof(ALLELE_TYPE));
+  buffers->alternate = (ALLELE_TYPE *)malloc(num_loci_allocation * sizeof(ALLELE_TYPE));
+}
+
+/*! \brief Deallocates buffers allocated by allocatePackedBuffers().
+ */
+void deallocatePackedBuffers(struct packed_buffers *buffers, int bottleneck_indivs_count, int final_indivs_count){
+  int i, j;
+  for(i = 0; i < 2; i++){
+    for(j = 0; j < bottleneck_indivs_count; j++){
+      free(buffers->females[i][j].pbits);
+      free(buffers->females[i][j].mbits);
+      free(buffers->males[i][j].pbits);
+      free(buffers->males[i][j].mbits);
+    }
+    free(buffers->females[i]);
+    free(buffers->males[i]);
+  }
+  for(j = 0; j < final_indivs_count; j++){
+    free(buffers->sample[j].pbits);
+    free(buffers->sample[j].mbits);
+  }
+  free(buffers->sample);
+  free(buffers->reference);
+  free(buffers->alternate);
+}
+
+/*! \brief Marks the reference and alternate allele of loci first_locus to last_locus - 1 as unknown.
+ */
+void resetPackedAlleles(ALLELE_TYPE *reference, ALLELE_TYPE *alternate, int first_locus, int last_locus){
+  int l;
+  for(l = first_locus; l < last_locus; l++){
+    reference[l] = 0;
+    alternate[l] = 0;
+  }
+}
+
+/*! \brief Records the alleles seen in a group of individuals at loci first_locus to last_locus - 1.
+ *
+ * The first allele seen at a locus becomes its reference, and the first
+ * different one its alternate. A locus with no alternate is monomorphic. If
+ * listed is not NULL, only the count individuals it lists are looked at.
+ */
+void findPackedAlleles(ALLELE_TYPE *reference, ALLELE_TYPE *alternate, struct gtype_type *individuals, const int *listed, int count, int first_locus, int last_locus){
+  int j, l, o;
+  for(o = 0; o < count; o++){
+    j = listed == NULL ? o : listed[o];
+    for(l = first_locus; l < last_locus; l++){
+      if(reference[l] == 0) reference[l] = individuals[j].pgtype[l];
+      if(alternate[l] == 0 && individuals[j].pgtype[l] != reference[l]) alternate[l] = individuals[j].pgtype[l];
+      if(alternate[l] == 0 && individuals[j].mgtype[l] != reference[l]) alternate[l] = individuals[j].mgtype[l];
+    }
+  }
+}
+
+/*! \brief Packs loci first_locus to last_locus - 1 of a group of individuals into bit-planes.
+ *
+ * An allele is stored as 1 when it differs from the reference of its locus.
+ * The first locus must start a word; bits past last_locus in the last word
+ * are cleared. If listed is not NULL, only the count individuals it lists are
+ * packed.
+ */
+void packGeneration(struct packed_gtype_type *packed, struct gtype_type *individuals, const int *listed, int count, int first_locus, int last_locus, const ALLELE_TYPE *reference){
+  int j, l, w, o;
+  for(o = 0; o < count; o++){
+    j = listed == NULL ? o : listed[o];
+    for(w = first_locus / PACKED_WORD_BITS; w < packedWords(last_locus); w++){
+      packed[j].pbits[w] = 0;
+      packed[j].mbits[w] = 0;
+    }
+    for(l = first_locus; l < last_locus; l++){
+      unsigned long long bit = 1ULL << (l % PACKED_WORD_BITS);
+      if(individuals[j].pgtype[l] != reference[l]) packed[j].pbits[l / PACKED_WORD_BITS] |= bit;
+      if(individuals[j].mgtype[l] != reference[l]) packed[j].mbits[l / PACKED_WORD_BITS] |= bit;
+    }
+  }
+}
+
+/*! \brief Unpacks loci first_locus to last_locus - 1 of bit-planes back into one ALLELE_TYPE per allele.
+ *
+ * A set bit at a locus that had no alternate allele can only come from a
+ * mutation; it is given the next base after the reference.
+ */
+void unpackGeneration(struct gtype_type *individuals, struct packed_gtype_type *packed, int count, int first_locus, int last_locus, const ALLELE_TYPE *reference, const ALLELE_TYPE *alternate){
+  int j, l;
+  for(l = first_locus; l < last_locus; l++){
+    int shift = l % PACKED_WORD_BITS;
+    ALLELE_TYPE other = alternate[l] != 0 ? alternate[l] : reference[l] % 4 + 1;
+    for(j = 0; j < count; j++){
+      individuals[j].pgtype[l] = (packed[j].pbits[l / PACKED_WORD_BITS] >> shift) & 1 ? other : reference[l];
+      individuals[j].mgtype[l] = (packed[j].mbits[l / PACKED_WORD_BITS] >> shift) & 1 ? other : reference[l];
+    }
+  }
+}
+
+/*! \brief Generates loci first_locus to last_locus - 1 of the next generation of packed individuals.
+ *
+ * Same model as assortLoci(), but each parent passes on a word of 64 loci at
+ * once: a random mask word picks the maternal or paternal copy of every locus.
+ * A mutation flips the allele to the other base of its locus. The first locus
+ * must start a word. If offspring is not NULL, only the next_gen_count
+ * offspring it lists are generated.
+ */
+void assortPacked(int next_gen_count, struct packed_gtype_type *offvec, struct packed_gtype_type *mothers, struct packed_gtype_type *fathers, const int *mother_index, const int *father_index, const int *offspring, int samp, int first_locus, int last_locus)
+{
+  // Read in mutation rate
+  double logNoMutation = log1p(-parseMRate(samp));
+  int num_loci = last_locus - first_locus;
+  long long alleles = 2LL * next_gen_count * num_loci;
+  long long allele;
+  int j, w, l, m, d, o;
+  // Simulate each individual's genotype
+  for(o = 0; o < next_gen_count; ++o){
+    j = offspring == NULL ? o : offspring[o];
+    m = mother_index[j];
+    d = father_index[j];
+    for(w = first_locus / PACKED_WORD_BITS; w < packedWords(last_locus); ++w){
+      unsigned long long mask = randomWord64();
+      offvec[j].mbits[w] = (mothers[m].mbits[w] & mask) | (mothers[m].pbits[w] & ~mask);
+      mask = randomWord64();
+      offvec[j].pbits[w] = (fathers[d].mbits[w] & mask) | (fathers[d].pbits[w] & ~mask);
+    }
+  }
+  // Mutate at alleles picked the same way as in assortLoci()
+  for(allele = randomGeometricSkip(logNoMutation); allele < alleles; allele += 1 + randomGeometricSkip(logNoMutation)){
+    o = allele / (2 * num_loci);
+    j = offspring == NULL ? o : offspring[o];
+    l = first_locus + (allele / 2) % num_loci;
+    (allele % 2 == 0 ? offvec[j].mbits : offvec[j].pbits)[l / PACKED_WORD_BITS] ^= 1ULL << (l % PACKED_WORD_BITS);
+  }
+}
+
+/*! \brief Simulates loci first_locus to last_locus - 1 through every generation of a pedigree, packed.
+ *
+ * Same as dropPedigreeLoci(): the ancestors among the founders in females[0]
+ * and males[0] are packed, bred through the pedigree in the bit-planes of
+ * buffers, and the final sample is unpacked into sample, after the samples of
+ * any earlier checkpoints. The first locus must start a word.
+ */
+void dropPackedPedigreeLoci(const struct pedigree *ped, struct packed_buffers *buffers, struct gtype_type *females[2], struct gtype_type *males[2], struct gtype_type *sample, int samp, int first_locus, int last_locus){
+  int current = 0;
+  int next = 1;
+  int g;
+  resetPackedAlleles(buffers->reference, buffers->alternate, first_locus, last_locus);
+  findPackedAlleles(buffers->reference, buffers->alternate, females[0], pedigreeAncestors(ped, 0, 0), pedigreeAncestorCount(ped, 0, 0), first_locus, last_locus);
+  findPackedAlleles(buffers->reference, buffers->alternate, males[0], pedigreeAncestors(ped, 0, 1), pedigreeAncestorCount(ped, 0, 1), first_locus, last_locus);
+  packGeneration(buffers->females[0], females[0], pedigreeAncestors(ped, 0, 0), pedigreeAncestorCount(ped, 0, 0), first_locus, last_locus, buffers->reference);
+  packGeneration(buffers->males[0], males[0], pedigreeAncestors(ped, 0, 1), pedigreeAncestorCount(ped, 0, 1), first_locus, last_locus, buffers->reference);
+  for(g = 0; g < ped->generations; g++){
+    if(g >= ped->first_checkpoint){
+      assortPacked(ped->sample_count, buffers->sample, buffers->females[current], buffers->males[current], pedigreeMothers(ped, pedigreeCheckpointBrood(ped, g)), pedigreeFathers(ped, pedigreeCheckpointBrood(ped, g)), NULL, samp, first_locus, last_locus);
+      unpackGeneration(sample + (g - ped->first_checkpoint) * ped->sample_count, buffers->sample, ped->sample_count, first_locus, last_locus, buffers->reference, buffers->alternate);
+    }
+    assortPacked(pedigreeAncestorCount(ped, g + 1, 0), buffers->females[next], buffers->females[current], buffers->males[current], pedigreeMothers(ped, 2 * g), pedigreeFathers(ped, 2 * g), pedigreeAncestors(ped, g + 1, 0), samp, first_locus, last_locus);
+    assortPacked(pedigreeAncestorCount(ped, g + 1, 1), buffers->males[next], buffers->females[current], buffers->males[current], pedigreeMothers(ped, 2 * g + 1), pedigreeFathers(ped, 2 * g + 1), pedigreeAncestors(ped, g + 1, 1), samp, first_locus, last_locus);
+    current = next;
+    next = 1 - next;
+  }
+  assortPacked(ped->sample_count, buffers->sample, buffers->females[current], buffers->males[current], pedigreeMothers(ped, pedigreeSampleBrood(ped)), pedigreeFathers(ped, pedigreeSampleBrood(ped)), NULL, samp, first_locus, last_locus);
+  unpackGeneration(sample + (ped->generations - ped->first_checkpoint) * ped->sample_count, buffers->sample, ped->sample_count, first_locus, last_locus, buffers->reference, buffers->alternate);
+}
+
+/*! \brief Allocates zygosity planes for count individuals and num_loci loci.
+ */
+void allocateZygosityPlanes(struct zygosity_planes *planes, int count, int num_loci){
+  planes->num_words = packedWords(num_loci);
+  planes->count = count;
+  planes->homozygous = (unsigned long long *)malloc(count * planes->num_words * sizeof(unsigned long long));
+  planes->missing = (unsigned long long *)malloc(count * planes->num_words * sizeof(unsigned long long));
+}
+
+/*! \brief Deallocates planes allocated by allocateZygosityPlanes().
+ */
+void deallocateZygosityPlanes(struct zygosity_planes *planes){
+  free(planes->homozygous);
+  free(planes->missing);
+}
+
+/*! \brief Packs the zygosity of loci 0 to num_loci - 1 of the individuals of a sample.
+ *
+ * Bits past num_loci in the last word are cleared.
+ */
+void packZygosity(struct zygosity_planes *planes, struct gtype_type *sample, int num_loci){
+  int j, w, b;
+  for(j = 0; j < planes->count; j++){
+    const ALLELE_TYPE *pgtype = sample[j].pgtype;
+    const ALLELE_TYPE *mgtype = sample[j].mgtype;
+    for(w = 0; w < planes->num_words; w++){
+      unsigned long long homozygous = 0;
+      unsigned long long missing = 0;
+      int first = w * PACKED_WORD_BITS;
+      int bits = num_loci - first < PACKED_WORD_BITS ? num_loci - first : PACKED_WORD_BITS;
+      for(b = 0; b < bits; b++){
+        homozygous |= (unsigned long long) (pgtype[first + b] == mgtype[first + b]) << b;
+        missing |= (unsigned long long) (pgtype[first + b] == 0 || mgtype[first + b] == 0) << b;
+      }
+      planes->homozygous[j * planes->num_words + w] = homozygous;
+      planes->missing[j * planes->num_words + w] = missing;
+    }
+  }
+}
+
+/*! \brief Allocates missing-allele masks for count individuals and num_loci loci.
+ */
+void allocateMissingMasks(struct missing_masks *masks, int count, int num_loci){
+  masks->num_words = packedWords(num_loci);
+  masks->count = count;
+  masks->paternal = (unsigned long long *)malloc(count * masks->num_words * sizeof(unsigned long long));
+  masks->maternal = (unsigned long long *)malloc(count * masks->num_words * sizeof(unsigned long long));
+}
+
+/*! \brief Deallocates masks allocated by allocateMissingMasks().
+ */
+void deallocateMissingMasks(struct missing_masks *masks){
+  free(masks->paternal);
+  free(masks->maternal);
+}
+
+/*! \brief Sets the masks to the missing alleles of the first num_loci loci of individuals.
+ */
+void packMissingMasks(struct missing_masks *masks, struct gtype_type *individuals, int num_loci){
+  int j, w, b;
+  for(j = 0; j < masks->count; j++){
+    for(w = 0; w < masks->num_words; w++){
+      unsigned long long paternal = 0;
+      unsigned long long maternal = 0;
+      int first = w * PACKED_WORD_BITS;
+      int bits = num_loci - first < PACKED_WORD_BITS ? num_loci - first : PACKED_WORD_BITS;
+      for(b = 0; b < bits; b++){
+        paternal |= (unsigned long long) (individuals[j].pgtype[first + b] == 0) << b;
+        maternal |= (unsigned long long) (individuals[j].mgtype[first + b] == 0) << b;
+      }
+      masks->paternal[j * masks->num_words + w] = paternal;
+      masks->maternal[j * masks->num_words + w] = maternal;
+    }
+  }
+}
+
+/*! \brief Clears the alleles of individual that are missing in individual source of the masks.
+ *
+ * Missing data is sparse, so only the set bits of each word are visited.
+ */
+void applyMissingMask(const struct missing_masks *masks, int source, struct gtype_type *individual){
+  const unsigned long long *paternal = masks->paternal + source * masks->num_words;
+  const unsigned long long *maternal = masks->maternal + source * masks->num_words;
+  unsigned long long bits;
+  int w;
+  for(w = 0; w < masks->num_words; w++){
+    for(bits = paternal[w]; bits != 0; bits &= bits - 1) individual->pgtype[w * PACKED_WORD_BITS + __builtin_ctzll(bits)] = 0;
+    for(bits = maternal[w]; bits != 0; bits &= bits - 1) individual->mgtype[w * PACKED_WORD_BITS + __builtin_ctzll(bits)] = 0;
+  }
+}
+
+/*! \brief Counts, for each locus, the individuals whose bit is set in set and clear in clear.
+ *
+ * Each word of loci is summed over individuals in bit-sliced counters: plane b
+ * holds bit b of the count of every locus of the word, and adding an
+ * individual is a ripple of carries through the planes. clear may be NULL.
+ * totals receives num_loci counts.
+ */
+void countPackedLoci(const unsigned long long *set, const unsigned long long *clear, int count, int num_words, int num_loci, int *totals){
+  unsigned long long counter[8 * sizeof(int)];
+  int num_planes = 1;
+  int j, w, b, l;
+  while((1LL << num_planes) <= count) num_planes++;
+  for(w = 0; w < num_words; w++){
+    for(b = 0; b < num_planes; b++) counter[b] = 0;
+    for(j = 0; j < count; j++){
+      unsigned long long carry = set[j * num_words + w];
+      if(clear != NULL) carry &= ~clear[j * num_words + w];
+      for(b = 0; carry != 0; b++){
+        unsigned long long next = counter[b] & carry;
+        counter[b] ^= carry;
+        carry = next;
+      }
+    }
+    for(l = w * PACKED_WORD_BITS; l < num_loci && l < (w + 1) * PACKED_WORD_BITS; l++){
+      int total = 0;
+      for(b = 0; b < num_planes; b++) total |= (int) ((counter[b] >> (l % PACKED_WORD_BITS)) & 1) << b;
+      totals[l] = total;
+    }
+  }
+}
+
+/*! \brief Computes the excess heterozygosity statistics of one sample from its zygosity planes.
+ *
+ * Same as hetexcessAssist(), which reads the sample itself, and gives the
+ * same values: the homozygotes and missing genotypes of every locus are
+ * counted by countPackedLoci().
+ */
+void hetexcessPacked(int **numberOfAlleles, const struct zygosity_planes *planes, double *hetx, double *mnehet, int ***gType, int ****gcountPtr, int samp)
+{
+  int ***gcount = *gcountPtr;
+  int numloci = run_config.num_loci;
+  int *homozygotes = (int *)malloc(numloci * sizeof(int));
+  int *missing = (int *)malloc(numloci * sizeof(int));
+  int iloc, al1, dblp, ind, nonzeroindices, skiploc;
+  double sumhobs, sumhexp, obshomo, exphomo;
+
+  countPackedLoci(planes->homozygous, planes->missing, planes->count, planes->num_words, numloci, homozygotes);
+  countPackedLoci(planes->missing, NULL, planes->count, planes->num_words, numloci, missing);
+  sumhobs = sumhexp = skiploc = 0;
+  for(iloc = 0; iloc < numloci; iloc++) {
+    obshomo = exphomo = nonzeroindices = 0;
+    dblp = homozygotes[iloc];
+    ind = planes->count - missing[iloc]; // Number of legal pairs
+    obshomo += (double)dblp / ind; // Frequency of homozygotes
+    for(al1 = 0; al1 < numberOfAlleles[samp][iloc]; al1++) {
+      if(gType[samp][iloc][al1] == 0){ continue; }
+      nonzeroindices += gcount[samp][iloc][al1];
+      exphomo += gcount[samp][iloc][al1] * gcount[samp][iloc][al1]; // Expected frequency of homozygotes
+    }
+
+    if(nonzeroindices == 0 || ind == 0 || numberOfAlleles[samp][iloc] == 1 || (numberOfAlleles[samp][iloc] == 2 && (gType[samp][iloc][0] == 0 || gType[samp][iloc][1] == 0))) { skiploc++; continue; } // Number of heterozygotes is undefined or monoallelic site.
+    exphomo /= nonzeroindices * nonzeroindices;
+    double observedHeterozygoteFrequency = 1 - obshomo;
+    double expectedHeterozygoteFrequency = 1 - exphomo;
+    double sampleCorrectionFactor = ((double) ind) / (ind - 1);
+    sumhobs += observedHeterozygoteFrequency;
+
+    double samplehexp = sampleCorrectionFactor * (expectedHeterozygoteFrequency - observedHeterozygoteFrequency/(2*ind));
+
+    // Bounds check
+    if(!(samplehexp > 0)) samplehexp = 0;
+    if(!(samplehexp < 1)) samplehexp = 1;
+
+    sumhexp += samplehexp;
+  }
+  mnehet[samp] = sumhexp / (double) (numloci - skiploc);
+  hetx[samp] = (sumhexp == 0) ? 1/0.0 : 1 - sumhobs / sumhexp;
+  free(homozygotes);
+  free(missing);
+}
+
+/*! \brief Computes the moments of homozygosity of one sample from its zygosity planes.
+ *
+ * Same as multihAssist(): the homozygous loci of an individual are counted a
+ * word at a time.
+ */
+void multihPacked(const struct zygosity_planes *planes, double mhomo[], double varhomo[], double skhomo[], double kurhomo[], int samp)
+{
+  int final_indivs_count = planes->count;
+  int ind, i, w, cnt;
+  int *data = (int *) malloc(final_indivs_count * sizeof(int));
+  double s, ep, p, sdev;
+  s = 0;
+  for(ind = 0; ind < final_indivs_count; ind++) {
+    cnt = 0;
+    for(w = 0; w < planes->num_words; w++) cnt += __builtin_popcountll(planes->homozygous[ind * planes->num_words + w]);
+    data[ind] = cnt;
+    s += cnt;
+  }
+
+  mhomo[samp] = s/(double)final_indivs_count;
+
+  sdev = ep = varhomo[samp] = skhomo[samp] = kurhomo[samp] = 0.0;
+  for(i = 0; i < final_indivs_count; i++) {
+    s = data[i] - mhomo[samp];
+    ep += s;
+    varhomo[samp] += (p = s*s);
+    skhomo[samp] += (p *= s);
+    kurhomo[samp] += (p *= s);
+  }
+
+  varhomo[samp] = (varhomo[samp]-ep*ep/final_indivs_count)/(final_indivs_count-1);
+  sdev = sqrt(varhomo[samp]);
+  if (varhomo[samp]) {
+    skhomo[samp] /= (final_indivs_count*varhomo[samp]*sdev);
+    kurhomo[samp] /= (final_indivs_count*varhomo[samp]*varhomo[samp]);
+    kurhomo[samp] -= 3.0;
+  }
+
+  free(data);
+}
+
+/*! \brief Allocates allele planes for count individuals and num_loci loci with numberOfAlleles[l] alleles each.
+ */
+void allocateAllelePlanes(struct allele_planes *planes, int count, int num_loci, const int *numberOfAlleles){
+  int l, total = 0;
+  planes->num_words = packedWords(count);
+  planes->num_loci = num_loci;
+  planes->count = count;
+  planes->offsets = (int *)malloc(num_loci * sizeof(int));
+  for(l = 0; l < num_loci; l++){
+    planes->offsets[l] = total;
+    total += numberOfAlleles[l];
+  }
+  planes->maternal = (unsigned long long *)calloc((size_t) total * planes->num_words, sizeof(unsigned long long));
+  planes->paternal = (unsigned long long *)calloc((size_t) total * planes->num_words, sizeof(unsigned long long));
+  planes->present = (unsigned long long *)calloc((size_t) num_loci * planes->num_words, sizeof(unsigned long long));
+}
+
+/*! \brief Deallocates planes allocated by allocateAllelePlanes().
+ */
+void deallocateAllelePlanes(struct allele_planes *planes){
+  free(planes->maternal);
+  free(planes->paternal);
+  free(planes->present);
+  free(planes->offsets);
+}
+
+/*! \brief Packs the alleles of a sample into planes, for the alleles gType lists at each locus.
+ *
+ * The planes must be cleared, as allocateAllelePlanes() leaves them.
+ */
+void packAllelePlanes(struct allele_planes *planes, struct gtype_type *sample, const int *numberOfAlleles, int **gType){
+  int l, a, j;
+  for(l = 0; l < planes->num_loci; l++){
+    unsigned long long *present = planes->present + (size_t) l * planes->num_words;
+    for(j = 0; j < planes->count; j++){
+      unsigned long long bit = 1ULL << (j % PACKED_WORD_BITS);
+      int w = j / PACKED_WORD_BITS;
+      if(sample[j].mgtype[l] != 0) present[w] |= bit;
+      for(a = 0; a < numberOfAlleles[l]; a++){
+        size_t plane = (size_t) (planes->offsets[l] + a) * planes->num_words;
+        if(sample[j].mgtype[l] == gType[l][a]) planes->maternal[plane + w] |= bit;
+        if(sample[j].pgtype[l] == gType[l][a]) planes->paternal[plane + w] |= bit;
+      }
+    }
+  }
+}
+
+/*! \brief Adds value to the sum of a Neumaier compensated summation, keeping its rounding error in compensation.
+ */
+static inline void compensatedAdd(double *sum, double *compensation, double value){
+  double total = *sum + value;
+  if(fabs(*sum) >= fabs(value)) *compensation += (*sum - total) + value;
+  else *compensation += (value - total) + *sum;
+  *sum = total;
+}
+
+/*! \brief Counts the copies (ofreq) and homozygotes (psq) of each allele of a locus among the individuals set in valid.
+ */
+static void countAlleleTerms(const struct allele_planes *planes, const unsigned long long *valid, int locus, int num_alleles, int *ofreq, int *psq){
+  int a, w;
+  for(a = 0; a < num_alleles; a++){
+    const unsigned long long *m = planes->maternal + (size_t) (planes->offsets[locus] + a) * planes->num_words;
+    const unsigned long long *p = planes->paternal + (size_t) (planes->offsets[locus] + a) * planes->num_words;
+    ofreq[a] = psq[a] = 0;
+    for(w = 0; w < planes->num_words; w++){
+      ofreq[a] += __builtin_popcountll(valid[w] & m[w]) + __builtin_popcountll(valid[w] & p[w]);
+      psq[a] += __builtin_popcountll(valid[w] & m[w] & p[w]);
+    }
+  }
+}
+
+/*! \brief Computes iis of one sample from its allele planes.
+ *
+ * Same as twolocusiisAssist(). For a pair of loci, the individuals counted
+ * are those with both maternal alleles present (v). An individual carries
+ * c = m + p copies of an allele, from its maternal (m) and paternal (p)
+ * indicators, so with popcounts over v:
+ * - the frequency count is |m| + |p|;
+ * - the homozygote count is |m & p|;
+ * - the joint count, the sum of c1 * c2 over individuals, is
+ *   |m1 & m2| + |m1 & p2| + |p1 & m2| + |p1 & p2|.
+ *
+ * The frequency and homozygote counts of each locus are tabled once, over the
+ * individuals with its maternal allele present; they are only counted again
+ * for a pair whose other locus misses some of those individuals.
+ *
+ * The triangle of pairs is cut into tiles of LD_TILE_LOCI by LD_TILE_LOCI
+ * loci, handed out to num_threads threads as they free up. Each tile sums
+ * its r squared with compensation, and the tiles are added up in order, so the
+ * value does not depend on the number of threads.
+ */
+void twolocusiisPacked(int **numberOfAlleles, const struct allele_planes *planes, double iis[], int samp, int num_threads)
+{
+  int numloci = planes->num_loci;
+  int num_words = planes->num_words;
+  int num_blocks = (numloci + LD_TILE_LOCI - 1) / LD_TILE_LOCI;
+  int num_tiles = num_blocks * (num_blocks + 1) / 2;
+  int num_planes = numloci > 0 ? planes->offsets[numloci - 1] + numberOfAlleles[samp][numloci - 1] : 0;
+  double *tile_sums = (double *)malloc(2 * num_tiles * sizeof(double));
+  double *tile_compensations = tile_sums + num_tiles;
+  int *tile_pairs = (int *)malloc(num_tiles * sizeof(int));
+  int *present_counts = (int *)malloc(numloci * sizeof(int));
+  int *locus_ofreq = (int *)malloc(2 * num_planes * sizeof(int) + sizeof(int));
+  int *locus_psq = locus_ofreq + num_planes;
+  double sum = 0;
+  double compensation = 0;
+  int prs = 0;
+  int max_alleles = 0;
+  int iloc, t;
+  for(iloc = 0; iloc < numloci; iloc++) if(numberOfAlleles[samp][iloc] > max_alleles) max_alleles = numberOfAlleles[samp][iloc];
+
+  #pragma omp parallel num_threads(num_threads)
+  {
+    unsigned long long *valid = (unsigned long long *)malloc(num_words * sizeof(unsigned long long));
+    int *scratch = (int *)malloc(4 * max_alleles * sizeof(int) + sizeof(int));
+    int locus, block1, block2, jloc;
+
+    // Terms of each locus over the individuals with its maternal allele present
+    #pragma omp for
+    for(locus = 0; locus < numloci; locus++){
+      const unsigned long long *present = planes->present + (size_t) locus * num_words;
+      int w;
+      present_counts[locus] = 0;
+      for(w = 0; w < num_words; w++) present_counts[locus] += __builtin_popcountll(present[w]);
+      countAlleleTerms(planes, present, locus, numberOfAlleles[samp][locus], locus_ofreq + planes->offsets[locus], locus_psq + planes->offsets[locus]);
+    }
+
+    #pragma omp for schedule(dynamic, 1)
+    for(t = 0; t < num_tiles; t++){
+      double tile_sum = 0;
+      double tile_compensation = 0;
+      int pairs = 0;
+      // Tile t is block pair (block1, block2), block1 <= block2, in row order
+      int rest = t;
+      for(block1 = 0; rest >= num_blocks - block1; block1++) rest -= num_blocks - block1;
+      block2 = block1 + rest;
+      for(locus = block1 * LD_TILE_LOCI; locus < (block1 + 1) * LD_TILE_LOCI && locus < numloci; locus++){
+        const unsigned long long *present1 = planes->present + (size_t) locus * num_words;
+        int first = block2 * LD_TILE_LOCI > locus + 1 ? block2 * LD_TILE_LOCI : locus + 1;
+        for(jloc = first; jloc < (block2 + 1) * LD_TILE_LOCI && jloc < numloci; jloc++){
+          const unsigned long long *present2 = planes->present + (size_t) jloc * num_words;
+          int *ofreq1 = locus_ofreq + planes->offsets[locus];
+          int *psq1 = locus_psq + planes->offsets[locus];
+          int *ofreq2 = locus_ofreq + planes->offsets[jloc];
+          int *psq2 = locus_psq + planes->offsets[jloc];
+          int cnt = 0;
+          int al1, al2, w;
+          for(w = 0; w < num_words; w++){
+            valid[w] = present1[w] & present2[w];
+            cnt += __builtin_popcountll(valid[w]);
+          }
+          if(cnt != present_counts[locus]){
+            ofreq1 = scratch;
+            psq1 = scratch + max_alleles;
+            countAlleleTerms(planes, valid, locus, numberOfAlleles[samp][locus], ofreq1, psq1);
+          }
+          if(cnt != present_counts[jloc]){
+            ofreq2 = scratch + 2 * max_alleles;
+            psq2 = scratch + 3 * max_alleles;
+            countAlleleTerms(planes, valid, jloc, numberOfAlleles[samp][jloc], ofreq2, psq2);
+          }
+          for(al1 = 0; al1 < numberOfAlleles[samp][locus]; al1++){
+            const unsigned long long *m1 = planes->maternal + (size_t) (planes->offsets[locus] + al1) * num_words;
+            const unsigned long long *p1 = planes->paternal + (size_t) (planes->offsets[locus] + al1) * num_words;
+            if(ofreq1[al1] == 2 * cnt) continue; // Monoallelic site
+            for(al2 = 0; al2 < numberOfAlleles[samp][jloc]; al2++){
+              const unsigned long long *m2 = planes->maternal + (size_t) (planes->offsets[jloc] + al2) * num_words;
+              const unsigned long long *p2 = planes->paternal + (size_t) (planes->offsets[jloc] + al2) * num_words;
+              int doublesum = 0;
+              double r;
+              if(ofreq2[al2] == 2 * cnt) continue; // Monoallelic site
+              for(w = 0; w < num_words; w++){
+                unsigned long long m1v = valid[w] & m1[w];
+                unsigned long long p1v = valid[w] & p1[w];
+                doublesum += __builtin_popcountll(m1v & m2[w]) + __builtin_popcountll(m1v & p2[w]) + __builtin_popcountll(p1v & m2[w]) + __builtin_popcountll(p1v & p2[w]);
+              }
+              r = compositeCorrelation(cnt, ofreq1[al1], ofreq2[al2], psq1[al1], psq2[al2], doublesum);
+              if(!(r == r)) continue; // Undefined, as LDNe skips it
+              compensatedAdd(&tile_sum, &tile_compensation, r*r);
+              pairs++;
+            }
+          }
+        }
+      }
+      tile_sums[t] = tile_sum;
+      tile_compensations[t] = tile_compensation;
+      tile_pairs[t] = pairs;
+    }
+    free(valid);
+    free(scratch);
+  }
+
+  for(t = 0; t < num_tiles; t++){
+    compensatedAdd(&sum, &compensation, tile_sums[t]);
+    compensation += tile_compensations[t];
+    prs += tile_pairs[t];
+  }
+  // Take the average of the r squared values
+  iis[samp] = (sum + compensation) / prs;
+  free(tile_sums);
+  free(tile_pairs);
+  free(present_counts);
+  free(locus_ofreq);
+}
@@ -0,0 +1,114 @@
+#include "../macro/refactor_macro.h"
+
+#ifndef REFACTOR_PACKED_H
+#define REFACTOR_PACKED_H
+
+/*! \def PACKED_WORD_BITS
+ *  \brief Number of loci stored in one word of a bit-plane.
+ */
+#define PACKED_WORD_BITS 64
+
+/*! \def packedWords(num_loci)
+ *  \brief Number of words needed to store one bit for each of num_loci loci.
+ */
+#define packedWords(num_loci) (((num_loci) + PACKED_WORD_BITS - 1) / PACKED_WORD_BITS)
+
+/*! \def LD_TILE_LOCI
+ *  \brief Loci on each side of a tile of the pairs of loci summed by twolocusiisPacked().
+ *  Tiles are fixed by the number of loci alone, so their sums do not depend
+ *  on the number of threads.
+ */
+#define LD_TILE_LOCI 32
+
+/*! \brief Genotype of one individual stored as two bit-planes.
+ *
+ * Bit l of pbits (mbits) is set when the paternal (maternal) allele of locus
+ * l is the alternate allele of that locus, and clear when it is the reference
+ * allele.
+ */
+struct packed_gtype_type {
+  unsigned long long *pbits;
+  unsigned long long *mbits;
+};
+typedef struct packed_gtype_type packed_gtype_type;
+
+/*! \brief Scratch generations of one thread when SNPs are simulated packed.
+ */
+struct packed_buffers {
+  struct packed_gtype_type *females[2];
+  struct packed_gtype_type *males[2];
+  struct packed_gtype_type *sample;
+  ALLELE_TYPE *reference;
+  ALLELE_TYPE *alternate;
+  int num_words;
+};
+typedef struct packed_buffers packed_buffers;
+
+/*! \brief Zygosity of every locus of a sample, as bit-planes.
+ *
+ * Word w of individual j is at index j * num_words + w. Bit l of homozygous
+ * is set when both alleles of locus l are equal (two missing alleles count as
+ * equal), and bit l of missing when either allele is missing (0).
+ */
+struct zygosity_planes {
+  unsigned long long *homozygous;
+  unsigned long long *missing;
+  int num_words;
+  int count;
+};
+typedef struct zygosity_planes zygosity_planes;
+
+/*! \brief Missing alleles of a group of individuals, as bit-planes.
+ *
+ * Word w of individual j is at index j * num_words + w. Bit l of paternal or
+ * maternal is set when that allele of locus l is missing (0).
+ */
+struct missing_masks {
+  unsigned long long *paternal;
+  unsigned long long *maternal;
+  int num_words;
+  int count;
+};
+typedef struct missing_masks missing_masks;
+
+/*! \brief Alleles of every locus of a sample, as bit-planes over its individuals.
+ *
+ * Plane offsets[l] + a of maternal (paternal) has bit j set when the maternal
+ * (paternal) allele of individual j at locus l is allele a of the locus, as
+ * listed in gType. Bit j of plane l of present is set when that maternal
+ * allele is not missing. Plane k starts at word k * num_words.
+ */
+struct allele_planes {
+  unsigned long long *maternal;
+  unsigned long long *paternal;
+  unsigned long long *present;
+  int *offsets;
+  int num_words;
+  int num_loci;
+  int count;
+};
+typedef struct allele_planes allele_planes;
+
+void allocatePackedBuffers(struct packed_buffers *buffers, int bottleneck_indivs_count, int final_indivs_count, int num_loci_allocation);
+void deallocatePackedBuffers(struct packed_buffers *buffers, int bottleneck_indivs_count, int final_indivs_count);
+void resetPackedAlleles(ALLELE_TYPE *reference, ALLELE_TYPE *alternate, int first_locus, int last_locus);
+void findPackedAlleles(ALLELE_TYPE *reference, ALLELE_TYPE *alternate, struct gtype_type *individuals, const int *listed, int count, int first_locus, int last_locus);
+void packGeneration(struct packed_gtype_type *packed, struct gtype_type *individuals, const int *listed, int count, int first_locus, int last_locus, const ALLELE_TYPE *reference);
+void unpackGeneration(struct gtype_type *individuals, struct packed_gtype_type *packed, int count, int first_locus, int last_locus, const ALLELE_TYPE *reference, const ALLELE_TYPE *alternate);
+void assortPacked(int next_gen_count, struct packed_gtype_type *offvec, struct packed_gtype_type *mothers, struct packed_gtype_type *fathers, const int *mother_index, const int *father_index, const int *offspring, int samp, int first_locus, int last_locus);
+void dropPackedPedigreeLoci(const struct pedigree *ped, struct packed_buffers *buffers, struct gtype_type *females[2], struct gtype_type *males[2], struct gtype_type *sample, int samp, int first_locus, int last_locus);
+void allocateZygosityPlanes(struct zygosity_planes *planes, int count, int num_loci);
+void deallocateZygosityPlanes(struct zygosity_planes *planes);
+void packZygosity(struct zygosity_planes *planes, struct gtype_type *sample, int num_loci);
+void allocateMissingMasks(struct missing_masks *masks, int count, int num_loci);
+void deallocateMissingMasks(struct missing_masks *masks);
+void packMissingMasks(struct missing_masks *masks, struct gtype_type *individuals, int num_loci);
+void applyMissingMask(const struct missing_masks *masks, int source, struct gtype_type *individual);
+void countPackedLoci(const unsigned long long *set, const unsigned long long *clear, int count, int num_words, int num_loci, int *totals);
+void hetexcessPacked(int **numberOfAlleles, const struct zygosity_planes *planes, double *hetx, double *mnehet, int ***gType, int ****gcountPtr, int samp);
+void allocateAllelePlanes(struct allele_planes *planes, int count, int num_loci, const int *numberOfAlleles);
+void deallocateAllelePlanes(struct allele_planes *planes);
+void packAllelePlanes(struct allele_planes *planes, struct gtype_type *sample, const int *numberOfAlleles, int **gType);
+void twolocusiisPacked(int **numberOfAlleles, const struct allele_planes *planes, double iis[], int samp, int num_threads);
+void multihPacked(const struct zygosity_planes *planes, double mhomo[], double varhomo[], double skhomo[], double kurhomo[], int samp);
+#endif
@@ -0,0 +1,372 @@
+#include <gtest/gtest.h>
+
+extern "C"{
+#include "../macro/refactor_macro.h"
+}
+
+// Fills individual j of a group with biallelic SNPs (bases 1 and 3) at every
+// locus, following a fixed pattern.
+static void fillPattern(struct gtype_type *individuals, int count, int num_loci){
+  int j, l;
+  for(j = 0; j < count; j++){
+    for(l = 0; l < num_loci; l++){
+      individuals[j].pgtype[l] = ((l + j) % 3 == 0) ? 3 : 1;
+      individuals[j].mgtype[l] = ((l * j) % 5 == 1) ? 3 : 1;
+    }
+  }
+}
+
+// Packing and unpacking a generation gives back the same alleles, across a
+// word boundary.
+TEST(packed, pack_unpack){
+  const int count = 4;
+  const int num_loci = 70;
+  struct packed_buffers buffers;
+  struct gtype_type individuals[count], copy[count];
+  int j, l;
+
+  allocatePackedBuffers(&buffers, count, count, num_loci);
+  EXPECT_EQ(buffers.num_words, 2);
+  for(j = 0; j < count; j++){
+    individuals[j].pgtype = (ALLELE_TYPE *)malloc(num_loci * sizeof(ALLELE_TYPE));
+    individuals[j].mgtype = (ALLELE_TYPE *)malloc(num_loci * sizeof(ALLELE_TYPE));
+    copy[j].pgtype = (ALLELE_TYPE *)malloc(num_loci * sizeof(ALLELE_TYPE));
+    copy[j].mgtype = (ALLELE_TYPE *)malloc(num_loci * sizeof(ALLELE_TYPE));
+  }
+  fillPattern(individuals, count, num_loci);
+
+  resetPackedAlleles(buffers.reference, buffers.alternate, 0, num_loci);
+  findPackedAlleles(buffers.reference, buffers.alternate, individuals, NULL, count, 0, num_loci);
+  packGeneration(buffers.females[0], individuals, NULL, count, 0, num_loci, buffers.reference);
+  EXPECT_EQ(buffers.females[0][0].pbits[1] >> (num_loci - 64), 0ULL);  // Tail bits are clear
+  unpackGeneration(copy, buffers.females[0], count, 0, num_loci, buffers.reference, buffers.alternate);
+  for(j = 0; j < count; j++){
+    for(l = 0; l < num_loci; l++){
+      EXPECT_EQ(individuals[j].pgtype[l], copy[j].pgtype[l]);
+      EXPECT_EQ(individuals[j].mgtype[l], copy[j].mgtype[l]);
+    }
+  }
+
+  for(j = 0; j < count; j++){
+    free(individuals[j].pgtype);
+    free(individuals[j].mgtype);
+    free(copy[j].pgtype);
+    free(copy[j].mgtype);
+  }
+  deallocatePackedBuffers(&buffers, count, count);
+}
+
+// onesamp -rPHILOX5 -t1 -b4 -d2 -u0 -v0.1 -s -l100 -i6 -o1 -k -p
+// Without mutation every offspring allele is one of the two alleles of the
+// chosen parent, and both copies of a heterozygous parent get passed on.
+TEST(packed, assort_packed){
+  char a0[] = "onesamp";
+  char a1[] = "-rPHILOX5";
+  char a2[] = "-t1";
+  char a3[] = "-b4";
+  char a4[] = "-d2";
+  char a5[] = "-u0";
+  char a6[] = "-v0.1";
+  char a7[] = "-s";
+  char a8[] = "-l100";
+  char a9[] = "-i6";
+  char a10[] = "-o1";
+  char a11[] = "-k";
+  char a12[] = "-p";
+  char *argv[] = {a0, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12};
+  const int parents = 1;
+  const int offspring = 50;
+  const int num_loci = 100;
+  struct packed_buffers buffers;
+  struct gtype_type mother[parents], children[offspring];
+  int parent_index[offspring] = {0};
+  int j, l;
+  int fromMaternal = 0;
+  int heterozygous = 0;
+
+  parseArguments(13, argv);
+  EXPECT_EQ(parsePackedSNPs(), TRUE);
+  allocatePackedBuffers(&buffers, parents, offspring, num_loci);
+  mother[0].pgtype = (ALLELE_TYPE *)malloc(num_loci * sizeof(ALLELE_TYPE));
+  mother[0].mgtype = (ALLELE_TYPE *)malloc(num_loci * sizeof(ALLELE_TYPE));
+  for(j = 0; j < offspring; j++){
+    children[j].pgtype = (ALLELE_TYPE *)malloc(num_loci * sizeof(ALLELE_TYPE));
+    children[j].mgtype = (ALLELE_TYPE *)malloc(num_loci * sizeof(ALLELE_TYPE));
+  }
+  fillPattern(mother, parents, num_loci);
+
+  resetPackedAlleles(buffers.reference, buffers.alternate, 0, num_loci);
+  findPackedAlleles(buffers.reference, buffers.alternate, mother, NULL, parents, 0, num_loci);
+  packGeneration(buffers.females[0], mother, NULL, parents, 0, num_loci, buffers.reference);
+  useRandomStream(0, RANDOM_SUBSTREAM_SIMULATION);
+  assortPacked(offspring, buffers.sample, buffers.females[0], buffers.females[0], parent_index, parent_index, NULL, 0, 0, num_loci);
+  unpackGeneration(children, buffers.sample, offspring, 0, num_loci, buffers.reference, buffers.alternate);
+
+  for(l = 0; l < num_loci; l++){
+    if(mother[0].pgtype[l] == mother[0].mgtype[l]) continue;
+    heterozygous++;
+    for(j = 0; j < offspring; j++){
+      EXPECT_TRUE(children[j].mgtype[l] == mother[0].pgtype[l] || children[j].mgtype[l] == mother[0].mgtype[l]);
+      if(children[j].mgtype[l] == mother[0].mgtype[l]) fromMaternal++;
+    }
+  }
+  for(l = 0; l < num_loci; l++){
+    if(mother[0].pgtype[l] != mother[0].mgtype[l]) continue;
+    for(j = 0; j < offspring; j++) EXPECT_EQ(children[j].pgtype[l], mother[0].pgtype[l]);
+  }
+  EXPECT_GT(heterozygous, 0);
+  EXPECT_GT(fromMaternal, heterozygous * offspring * 2 / 5);
+  EXPECT_LT(fromMaternal, heterozygous * offspring * 3 / 5);
+
+  free(mother[0].pgtype);
+  free(mother[0].mgtype);
+  for(j = 0; j < offspring; j++){
+    free(children[j].pgtype);
+    free(children[j].mgtype);
+  }
+  deallocatePackedBuffers(&buffers, parents, offspring);
+  flushArguments();
+}
+
+// onesamp -l70 -i9 -s -t1 -b8 -w -rC -d0 -v1 -u0.5 -o0
+// The statistics computed from zygosity planes equal those computed from the
+// sample itself, with missing alleles and across a word boundary.
+TEST(packed, zygosity_statistics){
+  char a0[] = "onesamp";
+  char a1[] = "-l70";
+  char a2[] = "-i9";
+  char a3[] = "-s";
+  char a4[] = "-t1";
+  char a5[] = "-b8";
+  char a6[] = "-w";
+  char a7[] = "-rC";
+  char a8[] = "-d0";
+  char a9[] = "-v1";
+  char a10[] = "-u0.5";
+  char a11[] = "-o0";
+  char *argv[] = {a0, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11};
+  const int count = 9;
+  const int num_loci = 70;
+  int **numberOfAlleles;
+  double *doubleData;
+  int ***gType;
+  int ***gcount;
+  struct zygosity_planes planes;
+  double scalar[6], packed[6];
+  int homozygotes[num_loci];
+  int j, l, k;
+
+  parseArguments(12, argv);
+  allocateOneSampMemory(0, 0, count, 1, num_loci, &numberOfAlleles, &doubleData, &gType, &gcount);
+  final_indivs_data = (struct gtype_type **)malloc(STRUCT_GTYPE_STAR_SIZE);
+  final_indivs_data[0] = (struct gtype_type *)malloc(count * STRUCT_GTYPE_SIZE);
+  for(j = 0; j < count; j++){
+    final_indivs_data[0][j].pgtype = (ALLELE_TYPE *)malloc(num_loci * sizeof(ALLELE_TYPE));
+    final_indivs_data[0][j].mgtype = (ALLELE_TYPE *)malloc(num_loci * sizeof(ALLELE_TYPE));
+    for(l = 0; l < num_loci; l++){
+      final_indivs_data[0][j].pgtype[l] = (7 * j + 3 * l) % 11 < 5 ? 1 : 3;
+      final_indivs_data[0][j].mgtype[l] = (5 * j + l * l) % 13 < 6 ? 1 : 3;
+      if((j * 31 + l * 17) % 23 == 0) final_indivs_data[0][j].pgtype[l] = 0;
+      if((j * 19 + l * 7) % 29 == 0) final_indivs_data[0][j].mgtype[l] = 0;
+    }
+  }
+  countsAssist(&numberOfAlleles, final_indivs_data, doubleData, gType, &gcount, 0);
+
+  hetexcessAssist(numberOfAlleles, 1, final_indivs_data, scalar, scalar + 1, gType, &gcount, 0);
+  multihAssist(1, final_indivs_data, scalar + 2, scalar + 3, scalar + 4, scalar + 5, gType, 0);
+  allocateZygosityPlanes(&planes, count, num_loci);
+  packZygosity(&planes, final_indivs_data[0], num_loci);
+  hetexcessPacked(numberOfAlleles, &planes, packed, packed + 1, gType, &gcount, 0);
+  multihPacked(&planes, packed + 2, packed + 3, packed + 4, packed + 5, 0);
+  for(k = 0; k < 6; k++) EXPECT_EQ(scalar[k], packed[k]);
+
+  // Counts of homozygotes match a direct count
+  countPackedLoci(planes.homozygous, NULL, count, planes.num_words, num_loci, homozygotes);
+  for(l = 0; l < num_loci; l++){
+    int expected = 0;
+    for(j = 0; j < count; j++) expected += final_indivs_data[0][j].pgtype[l] == final_indivs_data[0][j].mgtype[l];
+    EXPECT_EQ(homozygotes[l], expected);
+  }
+
+  deallocateZygosityPlanes(&planes);
+  for(j = 0; j < count; j++){
+    free(final_indivs_data[0][j].pgtype);
+    free(final_indivs_data[0][j].mgtype);
+  }
+  free(final_indivs_data[0]);
+  free(final_indivs_data);
+  deallocateOneSampMemory(0, 0, count, 1, num_loci, &numberOfAlleles, &doubleData, &gType, &gcount);
+  flushArguments();
+}
+
+// Applying the mask of an individual clears exactly the alleles missing in
+// it, across a word boundary.
+TEST(packed, missing_masks){
+  const int count = 3;
+  const int num_loci = 70;
+  struct missing_masks masks;
+  struct gtype_type individuals[count], target;
+  int j, l;
+
+  for(j = 0; j < count; j++){
+    individuals[j].pgtype = (ALLELE_TYPE *)malloc(num_loci * sizeof(ALLELE_TYPE));
+    individuals[j].mgtype = (ALLELE_TYPE *)malloc(num_loci * sizeof(ALLELE_TYPE));
+  }
+  target.pgtype = (ALLELE_TYPE *)malloc(num_loci * sizeof(ALLELE_TYPE));
+  target.mgtype = (ALLELE_TYPE *)malloc(num_loci * sizeof(ALLELE_TYPE));
+  fillPattern(individuals, count, num_loci);
+  for(j = 0; j < count; j++){
+    for(l = 0; l < num_loci; l++){
+      if((j * 31 + l * 17) % 11 == 0) individuals[j].pgtype[l] = 0;
+      if((j * 19 + l * 7) % 13 == 0) individuals[j].mgtype[l] = 0;
+    }
+  }
+
+  allocateMissingMasks(&masks, count, num_loci);
+  packMissingMasks(&masks, individuals, num_loci);
+  for(j = 0; j < count; j++){
+    for(l = 0; l < num_loci; l++){
+      target.pgtype[l] = 1;
+      target.mgtype[l] = 3;
+    }
+    applyMissingMask(&masks, j, &target);
+    for(l = 0; l < num_loci; l++){
+      EXPECT_EQ(target.pgtype[l], individuals[j].pgtype[l] == 0 ? 0 : 1);
+      EXPECT_EQ(target.mgtype[l], individuals[j].mgtype[l] == 0 ? 0 : 3);
+    }
+  }
+
+  deallocateMissingMasks(&masks);
+  for(j = 0; j < count; j++){
+    free(individuals[j].pgtype);
+    free(individuals[j].mgtype);
+  }
+  free(target.pgtype);
+  free(target.mgtype);
+}
+
+// onesamp -l12 -i70 -s -t1 -b8 -w -rC -d0 -v1 -u0.5 -o0
+// iis tallied from allele planes matches iis computed from the sample itself,
+// with missing alleles and individuals across a word boundary.
+TEST(packed, allele_planes_iis){
+  char a0[] = "onesamp";
+  char a1[] = "-l12";
+  char a2[] = "-i70";
+  char a3[] = "-s";
+  char a4[] = "-t1";
+  char a5[] = "-b8";
+  char a6[] = "-w";
+  char a7[] = "-rC";
+  char a8[] = "-d0";
+  char a9[] = "-v1";
+  char a10[] = "-u0.5";
+  char a11[] = "-o0";
+  char *argv[] = {a0, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11};
+  const int count = 70;
+  const int num_loci = 12;
+  int **numberOfAlleles;
+  double *doubleData;
+  int ***gType;
+  int ***gcount;
+  struct allele_planes planes;
+  double mnals[1], scalar[1], packed[1];
+  int j, l;
+
+  parseArguments(12, argv);
+  allocateOneSampMemory(0, 0, count, 1, num_loci, &numberOfAlleles, &doubleData, &gType, &gcount);
+  final_indivs_data = (struct gtype_type **)malloc(STRUCT_GTYPE_STAR_SIZE);
+  final_indivs_data[0] = (struct gtype_type *)malloc(count * STRUCT_GTYPE_SIZE);
+  for(j = 0; j < count; j++){
+    final_indivs_data[0][j].pgtype = (ALLELE_TYPE *)malloc(num_loci * sizeof(ALLELE_TYPE));
+    final_indivs_data[0][j].mgtype = (ALLELE_TYPE *)malloc(num_loci * sizeof(ALLELE_TYPE));
+    for(l = 0; l < num_loci; l++){
+      // Linked loci: the alleles of a locus lean on those of the one before
+      final_indivs_data[0][j].pgtype[l] = 1 + (7 * j + 3 * (l / 2)) % 11 % (2 + l % 3);
+      final_indivs_data[0][j].mgtype[l] = 1 + (5 * j + l * l) % 13 % (2 + l % 2);
+      if((j * 31 + l * 17) % 23 == 0) final_indivs_data[0][j].pgtype[l] = 0;
+      if((j * 19 + l * 7) % 29 == 0) final_indivs_data[0][j].mgtype[l] = 0;
+    }
+  }
+  countsAssist(&numberOfAlleles, final_indivs_data, mnals, gType, &gcount, 0);
+
+  twolocusiisAssist(numberOfAlleles, 1, final_indivs_data, scalar, gType, &gcount, 0);
+  allocateAllelePlanes(&planes, count, num_loci, numberOfAlleles[0]);
+  EXPECT_EQ(planes.num_words, 2);
+  packAllelePlanes(&planes, final_indivs_data[0], numberOfAlleles[0], gType[0]);
+  twolocusiisPacked(numberOfAlleles, &planes, packed, 0, 1);
+  EXPECT_GT(scalar[0], 0);
+  // Same terms, summed with compensation rather than in order
+  EXPECT_NEAR(scalar[0], packed[0], 1e-12 * scalar[0]);
+
+  deallocateAllelePlanes(&planes);
+  for(j = 0; j < count; j++){
+    free(final_indivs_data[0][j].pgtype);
+    free(final_indivs_data[0][j].mgtype);
+  }
+  free(final_indivs_data[0]);
+  free(final_indivs_data);
+  deallocateOneSampMemory(0, 0, count, 1, num_loci, &numberOfAlleles, &doubleData, &gType, &gcount);
+  flushArguments();
+}
+
+// onesamp -l100 -i40 -s -t1 -b8 -w -rC -d0 -v1 -u0.5 -o0
+// iis from allele planes is the same at any number of threads, over pairs of
+// loci in several tiles, and matches the value from the sample itself.
+TEST(packed, ld_tiles_deterministic){
+  char a0[] = "onesamp";
+  char a1[] = "-l100";
+  char a2[] = "-i40";
+  char a3[] = "-s";
+  char a4[] = "-t1";
+  char a5[] = "-b8";
+  char a6[] = "-w";
+  char a7[] = "-rC";
+  char a8[] = "-d0";
+  char a9[] = "-v1";
+  char a10[] = "-u0.5";
+  char a11[] = "-o0";
+  char *argv[] = {a0, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11};
+  const int count = 40;
+  const int num_loci = 100;
+  int **numberOfAlleles;
+  double *doubleData;
+  int ***gType;
+  int ***gcount;
+  struct allele_planes planes;
+  double mnals[1], scalar[1], serial[1], threaded[1];
+  int j, l;
+
+  parseArguments(12, argv);
+  allocateOneSampMemory(0, 0, count, 1, num_loci, &numberOfAlleles, &doubleData, &gType, &gcount);
+  final_indivs_data = (struct gtype_type **)malloc(STRUCT_GTYPE_STAR_SIZE);
+  final_indivs_data[0] = (struct gtype_type *)malloc(count * STRUCT_GTYPE_SIZE);
+  for(j = 0; j < count; j++){
+    final_indivs_data[0][j].pgtype = (ALLELE_TYPE *)malloc(num_loci * sizeof(ALLELE_TYPE));
+    final_indivs_data[0][j].mgtype = (ALLELE_TYPE *)malloc(num_loci * sizeof(ALLELE_TYPE));
+    for(l = 0; l < num_loci; l++){
+      final_indivs_data[0][j].pgtype[l] = 1 + (7 * j + 3 * (l / 2)) % 11 % (2 + l % 3);
+      final_indivs_data[0][j].mgtype[l] = 1 + (5 * j + l * l) % 13 % (2 + l % 2);
+      if((j * 31 + l * 17) % 97 == 0) final_indivs_data[0][j].mgtype[l] = 0;
+    }
+  }
+  countsAssist(&numberOfAlleles, final_indivs_data, mnals, gType, &gcount, 0);
+  ASSERT_GT(run_config.num_loci, 2 * LD_TILE_LOCI);
+
+  twolocusiisAssist(numberOfAlleles, 1, final_indivs_data, scalar, gType, &gcount, 0);
+  allocateAllelePlanes(&planes, count, num_loci, numberOfAlleles[0]);
+  packAllelePlanes(&planes, final_indivs_data[0], numberOfAlleles[0], gType[0]);
+  twolocusiisPacked(numberOfAlleles, &planes, serial, 0, 1);
+  twolocusiisPacked(numberOfAlleles, &planes, threaded, 0, 4);
+  EXPECT_EQ(serial[0], threaded[0]);
+  EXPECT_NEAR(scalar[0], serial[0], 1e-12 * scalar[0]);
+
+  deallocateAllelePlanes(&planes);
+  for(j = 0; j < count; j++){
+    free(final_indivs_data[0][j].pgtype);
+    free(final_indivs_data[0][j].mgtype);
+  }
+  free(final_indivs_data[0]);
+  free(final_indivs_data);
+  deallocateOneSampMemory(0, 0, count, 1, num_loci, &numberOfAlleles, &doubleData, &gType, &gcount);
+  flushArguments();
+}
@@ -628,7 +628,7 @@ int variantsOfFinalLocus(int sample, int locusI){
   int geneA2;
   int nonZeroVariant = 0;
   int i;
-  for(i = 0; i < parseInputSamples(); i++){
+  for(i = 0; i < run_config.input_samples; i++){
     loadFinalGenotype(sample, i, locusI, &geneA1, &geneA2);
     if(nonZeroVariant == 0) nonZeroVariant = geneA1;
     if(nonZeroVariant == 0) nonZeroVariant = geneA2;
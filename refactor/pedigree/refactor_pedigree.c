@@ -0,0 +1,159 @@
+/*! \file refactor_pedigree.c
+ *  \brief Recorded mating pedigrees for OneSamp.
+ *
+ * Loci are unlinked, so which individuals mate is the same for every locus and
+ * only the inherited copy differs. Drawing the parents of every generation up
+ * front lets a range of loci be simulated through the pedigree at any time,
+ * e.g. to replace loci that came out monomorphic.
+ *
+ * It also shows which individuals are ancestors of the final sample before any
+ * allele is simulated. With a large bottleneck most individuals leave no
+ * descendant in a sample of a few dozen, and skipping them leaves the
+ * distribution of the sample unchanged.
+ *
+ * A pedigree can also breed a sample from each of its last generations
+ * (checkpoints), so that one trajectory gives a sample for every duration of
+ * the bottleneck up to its own.
+ */
+
+#include "refactor_pedigree.h"
+
+/*! \brief Allocates a pedigree of up to max_generations bottleneck generations.
+ *
+ * Room is left for a checkpoint sample after every generation.
+ */
+void allocatePedigree(struct pedigree *ped, int max_generations, int bottleneck_indivs_count, int final_indivs_count){
+  int broods = 3 * max_generations + 1;
+  ped->brood_allocation = bottleneck_indivs_count > final_indivs_count ? bottleneck_indivs_count : final_indivs_count;
+  ped->mothers = (int *)malloc(broods * ped->brood_allocation * sizeof(int));
+  ped->fathers = (int *)malloc(broods * ped->brood_allocation * sizeof(int));
+  ped->ancestors = (int *)malloc(2 * (max_generations + 1) * ped->brood_allocation * sizeof(int));
+  ped->ancestor_counts = (int *)malloc(2 * (max_generations + 1) * sizeof(int));
+  ped->flags = (unsigned char *)calloc(2 * ped->brood_allocation, sizeof(unsigned char));
+  ped->generations = 0;
+  ped->first_checkpoint = 0;
+  ped->parents_count = 0;
+  ped->sample_count = 0;
+}
+
+/*! \brief Deallocates a pedigree allocated by allocatePedigree().
+ */
+void deallocatePedigree(struct pedigree *ped){
+  free(ped->mothers);
+  free(ped->fathers);
+  free(ped->ancestors);
+  free(ped->ancestor_counts);
+  free(ped->flags);
+}
+
+/*! \brief Chooses a random mother and father for every individual.
+ *
+ * Each of the generations bottleneck generations has parents_count females and
+ * as many males, and is bred from the one before; the sample_count individuals
+ * of the final sample are bred from the last. The ancestors of the sample are
+ * then found with findPedigreeAncestors().
+ */
+void drawPedigree(struct pedigree *ped, int generations, int parents_count, int sample_count){
+  drawCheckpointPedigree(ped, generations, generations, parents_count, sample_count);
+}
+
+/*! \brief Chooses parents as drawPedigree(), with a sample of sample_count bred from every generation from first_checkpoint on.
+ *
+ * The broods are drawn in order, so the final sample and the generations
+ * before it are drawn as by drawPedigree().
+ */
+void drawCheckpointPedigree(struct pedigree *ped, int first_checkpoint, int generations, int parents_count, int sample_count){
+  int brood, j;
+  ped->generations = generations;
+  ped->first_checkpoint = first_checkpoint;
+  ped->parents_count = parents_count;
+  ped->sample_count = sample_count;
+  for(brood = 0; brood <= pedigreeCheckpointBrood(ped, first_checkpoint); brood++){
+    int count = brood >= pedigreeSampleBrood(ped) ? sample_count : parents_count;
+    for(j = 0; j < count; j++){
+      pedigreeMothers(ped, brood)[j] = randomBounded(parents_count);
+      pedigreeFathers(ped, brood)[j] = randomBounded(parents_count);
+    }
+  }
+  findPedigreeAncestors(ped);
+}
+
+/*! \brief Lists the ancestors of the final sample in every generation.
+ *
+ * Walks the pedigree backwards from the sample, marking the parents of each
+ * ancestor found so far, and of the checkpoint sample of each generation.
+ */
+void findPedigreeAncestors(struct pedigree *ped){
+  unsigned char *female_flags = ped->flags;
+  unsigned char *male_flags = ped->flags + ped->brood_allocation;
+  int g, sex, j, k;
+  for(g = ped->generations; g >= 0; g--){
+    // Parents of the sample bred from generation g
+    if(g >= ped->first_checkpoint){
+      for(j = 0; j < ped->sample_count; j++){
+        female_flags[pedigreeMothers(ped, pedigreeCheckpointBrood(ped, g))[j]] = 1;
+        male_flags[pedigreeFathers(ped, pedigreeCheckpointBrood(ped, g))[j]] = 1;
+      }
+    }
+    // Turn the marks of generation g into lists
+    for(sex = 0; sex < 2; sex++){
+      unsigned char *flags = sex == 0 ? female_flags : male_flags;
+      pedigreeAncestorCount(ped, g, sex) = 0;
+      for(j = 0; j < ped->parents_count; j++){
+        if(!flags[j]) continue;
+        pedigreeAncestors(ped, g, sex)[pedigreeAncestorCount(ped, g, sex)++] = j;
+        flags[j] = 0;
+      }
+    }
+    if(g == 0) break;
+    // Mark their parents in generation g - 1
+    for(sex = 0; sex < 2; sex++){
+      for(k = 0; k < pedigreeAncestorCount(ped, g, sex); k++){
+        j = pedigreeAncestors(ped, g, sex)[k];
+        female_flags[pedigreeMothers(ped, 2 * (g - 1) + sex)[j]] = 1;
+        male_flags[pedigreeFathers(ped, 2 * (g - 1) + sex)[j]] = 1;
+      }
+    }
+  }
+}
+
+/*! \brief Returns how many loci to breed through a pedigree at a time.
+ *
+ * Sizes a tile so that the ancestors of the widest pair of successive
+ * generations hold about PEDIGREE_TILE_BYTES of alleles, at bits_per_allele
+ * bits each. Tiles are a whole number of packed words.
+ */
+int pedigreeTileLoci(const struct pedigree *ped, int bits_per_allele){
+  int widest = ped->sample_count + pedigreeAncestorCount(ped, ped->generations, 0) + pedigreeAncestorCount(ped, ped->generations, 1);
+  int g, pair, tile;
+  for(g = 0; g < ped->generations; g++){
+    pair = pedigreeAncestorCount(ped, g, 0) + pedigreeAncestorCount(ped, g, 1) + pedigreeAncestorCount(ped, g + 1, 0) + pedigreeAncestorCount(ped, g + 1, 1);
+    if(g >= ped->first_checkpoint) pair += ped->sample_count;
+    if(pair > widest) widest = pair;
+  }
+  tile = 8LL * PEDIGREE_TILE_BYTES / (2LL * widest * bits_per_allele);
+  tile -= tile % PACKED_WORD_BITS;
+  return tile > PACKED_WORD_BITS ? tile : PACKED_WORD_BITS;
+}
+
+/*! \brief Simulates loci first_locus to last_locus - 1 through every generation of a pedigree.
+ *
+ * The founders are read from females[0] and males[0]; only the ancestors among
+ * them need to be set. The two generations of females and males are then used
+ * alternately as scratch, breeding only ancestors of the sample, and the loci
+ * of the final sample are written to sample. With checkpoints, the sample of
+ * each is written to sample in turn, earliest first.
+ */
+void dropPedigreeLoci(const struct pedigree *ped, struct gtype_type *females[2], struct gtype_type *males[2], struct gtype_type *sample, int samp, int first_locus, int last_locus){
+  int current = 0;
+  int next = 1;
+  int g;
+  for(g = 0; g < ped->generations; g++){
+    if(g >= ped->first_checkpoint) assortLoci(ped->sample_count, sample + (g - ped->first_checkpoint) * ped->sample_count, females[current], males[current], pedigreeMothers(ped, pedigreeCheckpointBrood(ped, g)), pedigreeFathers(ped, pedigreeCheckpointBrood(ped, g)), NULL, samp, first_locus, last_locus);
+    assortLoci(pedigreeAncestorCount(ped, g + 1, 0), females[next], females[current], males[current], pedigreeMothers(ped, 2 * g), pedigreeFathers(ped, 2 * g), pedigreeAncestors(ped, g + 1, 0), samp, first_locus, last_locus);
+    assortLoci(pedigreeAncestorCount(ped, g + 1, 1), males[next], females[current], males[current], pedigreeMothers(ped, 2 * g + 1), pedigreeFathers(ped, 2 * g + 1), pedigreeAncestors(ped, g + 1, 1), samp, first_locus, last_locus);
+    current = next;
+    next = 1 - next;
+  }
+  assortLoci(ped->sample_count, sample + (ped->generations - ped->first_checkpoint) * ped->sample_count, females[current], males[current], pedigreeMothers(ped, pedigreeSampleBrood(ped)), pedigreeFathers(ped, pedigreeSampleBrood(ped)), NULL, samp, first_locus, last_locus);
+}
@@ -0,0 +1,82 @@
+#include "../macro/refactor_macro.h"
+
+#ifndef REFACTOR_PEDIGREE_H
+#define REFACTOR_PEDIGREE_H
+
+/*! \brief Parents chosen for every individual of one iteration.
+ *
+ * Brood 2g holds the females and brood 2g + 1 the males of bottleneck
+ * generation g + 1, both bred from generation g (the founders are generation
+ * 0). Brood 2 * generations holds the final sample.
+ *
+ * With checkpoints, a sample is also bred from every generation from
+ * first_checkpoint on; the broods of those before the last follow the final
+ * sample, latest first.
+ *
+ * Only ancestors of the final sample can pass alleles on to it, so they are
+ * also listed for each sex of each generation, founders included.
+ */
+struct pedigree {
+  int *mothers;
+  int *fathers;
+  int *ancestors;
+  int *ancestor_counts;
+  unsigned char *flags;
+  int brood_allocation;
+  int generations;
+  int first_checkpoint;
+  int parents_count;
+  int sample_count;
+};
+typedef struct pedigree pedigree;
+
+/*! \def PEDIGREE_TILE_BYTES
+ *  \brief Target size of the alleles of a tile of loci in two successive generations.
+ *  Small enough for a tile to stay in a typical L2 cache while it is bred
+ *  through every generation.
+ */
+#define PEDIGREE_TILE_BYTES (128 * 1024)
+
+/*! \def pedigreeMothers(ped, brood)
+ *  \brief Indices of the mothers of each individual of a brood.
+ */
+#define pedigreeMothers(ped, brood) ((ped)->mothers + (brood) * (ped)->brood_allocation)
+
+/*! \def pedigreeFathers(ped, brood)
+ *  \brief Indices of the fathers of each individual of a brood.
+ */
+#define pedigreeFathers(ped, brood) ((ped)->fathers + (brood) * (ped)->brood_allocation)
+
+/*! \def pedigreeAncestors(ped, generation, sex)
+ *  \brief Ascending indices of the females (sex 0) or males (sex 1) of a generation that are ancestors of the sample.
+ */
+#define pedigreeAncestors(ped, generation, sex) ((ped)->ancestors + (2 * (generation) + (sex)) * (ped)->brood_allocation)
+
+/*! \def pedigreeAncestorCount(ped, generation, sex)
+ *  \brief Number of females (sex 0) or males (sex 1) of a generation that are ancestors of the sample.
+ */
+#define pedigreeAncestorCount(ped, generation, sex) ((ped)->ancestor_counts[2 * (generation) + (sex)])
+
+/*! \def pedigreeSampleBrood(ped)
+ *  \brief Brood of the final sample.
+ */
+#define pedigreeSampleBrood(ped) (2 * (ped)->generations)
+
+/*! \def pedigreeCheckpointBrood(ped, generation)
+ *  \brief Brood of the sample bred from a generation, for generations from first_checkpoint on.
+ */
+#define pedigreeCheckpointBrood(ped, generation) (3 * (ped)->generations - (generation))
+
+/*! \def pedigreeCheckpointCount(ped)
+ *  \brief Number of samples bred from the pedigree, one per checkpoint.
+ */
+#define pedigreeCheckpointCount(ped) ((ped)->generations - (ped)->first_checkpoint + 1)
+
+void allocatePedigree(struct pedigree *ped, int max_generations, int bottleneck_indivs_count, int final_indivs_count);
+void deallocatePedigree(struct pedigree *ped);
+void drawPedigree(struct pedigree *ped, int generations, int parents_count, int sample_count);
+void drawCheckpointPedigree(struct pedigree *ped, int first_checkpoint, int generations, int parents_count, int sample_count);
+void findPedigreeAncestors(struct pedigree *ped);
+int pedigreeTileLoci(const struct pedigree *ped, int bits_per_allele);
+void dropPedigreeLoci(const struct pedigree *ped, struct gtype_type *females[2], struct gtype_type *males[2], struct gtype_type *sample, int samp, int first_locus, int last_locus);
+#endif
@@ -0,0 +1,243 @@
+#include <gtest/gtest.h>
+#include <string.h>
+
+extern "C"{
+#include "../macro/refactor_macro.h"
+}
+
+// onesamp -rPHILOX5 -t1 -b4 -d2 -u0 -v0.1 -s -l100 -i6 -o1 -p
+static void parseWithoutMutation(){
+  char a0[] = "onesamp";
+  char a1[] = "-rPHILOX5";
+  char a2[] = "-t1";
+  char a3[] = "-b4";
+  char a4[] = "-d2";
+  char a5[] = "-u0";
+  char a6[] = "-v0.1";
+  char a7[] = "-s";
+  char a8[] = "-l100";
+  char a9[] = "-i6";
+  char a10[] = "-o1";
+  char a11[] = "-p";
+  char *argv[] = {a0, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11};
+  parseArguments(12, argv);
+}
+
+// Every individual of every brood gets parents from the generation before.
+TEST(pedigree, draw_pedigree){
+  struct pedigree ped;
+  int brood, j;
+
+  parseWithoutMutation();
+  allocatePedigree(&ped, 3, 5, 8);
+  useRandomStream(0, RANDOM_SUBSTREAM_SIMULATION);
+  drawPedigree(&ped, 3, 5, 8);
+  EXPECT_EQ(pedigreeSampleBrood(&ped), 6);
+  for(brood = 0; brood <= pedigreeSampleBrood(&ped); brood++){
+    int count = brood == pedigreeSampleBrood(&ped) ? 8 : 5;
+    for(j = 0; j < count; j++){
+      EXPECT_GE(pedigreeMothers(&ped, brood)[j], 0);
+      EXPECT_LT(pedigreeMothers(&ped, brood)[j], 5);
+      EXPECT_GE(pedigreeFathers(&ped, brood)[j], 0);
+      EXPECT_LT(pedigreeFathers(&ped, brood)[j], 5);
+    }
+  }
+  deallocatePedigree(&ped);
+  flushArguments();
+}
+
+// The ancestors listed in each generation are exactly the parents of the
+// sample or of the ancestors listed in the generation after.
+TEST(pedigree, ancestors_of_sample){
+  const int generations = 3;
+  const int parents = 50;
+  const int sample_count = 4;
+  struct pedigree ped;
+  int g, sex, j, k;
+
+  parseWithoutMutation();
+  allocatePedigree(&ped, generations, parents, sample_count);
+  useRandomStream(0, RANDOM_SUBSTREAM_SIMULATION);
+  drawPedigree(&ped, generations, parents, sample_count);
+  for(g = generations; g >= 0; g--){
+    int expected[2][parents];
+    memset(expected, 0, sizeof(expected));
+    if(g == generations){
+      for(j = 0; j < sample_count; j++){
+        expected[0][pedigreeMothers(&ped, pedigreeSampleBrood(&ped))[j]] = 1;
+        expected[1][pedigreeFathers(&ped, pedigreeSampleBrood(&ped))[j]] = 1;
+      }
+    } else {
+      for(sex = 0; sex < 2; sex++){
+        for(k = 0; k < pedigreeAncestorCount(&ped, g + 1, sex); k++){
+          j = pedigreeAncestors(&ped, g + 1, sex)[k];
+          expected[0][pedigreeMothers(&ped, 2 * g + sex)[j]] = 1;
+          expected[1][pedigreeFathers(&ped, 2 * g + sex)[j]] = 1;
+        }
+      }
+    }
+    for(sex = 0; sex < 2; sex++){
+      int listed[parents];
+      memset(listed, 0, sizeof(listed));
+      for(k = 0; k < pedigreeAncestorCount(&ped, g, sex); k++){
+        if(k > 0) EXPECT_LT(pedigreeAncestors(&ped, g, sex)[k - 1], pedigreeAncestors(&ped, g, sex)[k]);
+        listed[pedigreeAncestors(&ped, g, sex)[k]] = 1;
+      }
+      for(j = 0; j < parents; j++) EXPECT_EQ(expected[sex][j], listed[j]);
+    }
+    // A small sample descends from few of a large generation
+    EXPECT_LE(pedigreeAncestorCount(&ped, g, 0), 2 * sample_count << (generations - g));
+  }
+  deallocatePedigree(&ped);
+  flushArguments();
+}
+
+// Tiles are whole packed words, and shrink as the ancestry widens.
+TEST(pedigree, tile_loci){
+  struct pedigree ped;
+  int narrow, wide;
+
+  parseWithoutMutation();
+  allocatePedigree(&ped, 2, 1000, 4);
+  useRandomStream(0, RANDOM_SUBSTREAM_SIMULATION);
+  drawPedigree(&ped, 0, 1000, 4);
+  narrow = pedigreeTileLoci(&ped, 8);
+  drawPedigree(&ped, 2, 1000, 4);
+  wide = pedigreeTileLoci(&ped, 8);
+  EXPECT_EQ(narrow % PACKED_WORD_BITS, 0);
+  EXPECT_EQ(wide % PACKED_WORD_BITS, 0);
+  EXPECT_GE(wide, PACKED_WORD_BITS);
+  EXPECT_GE(narrow, wide);
+  EXPECT_GE(pedigreeTileLoci(&ped, 1), pedigreeTileLoci(&ped, 8));
+  deallocatePedigree(&ped);
+  flushArguments();
+}
+
+// Loci simulated in separate ranges share the pedigree: without mutation,
+// every allele of a sample individual comes from the parents recorded for it.
+TEST(pedigree, drop_follows_pedigree){
+  const int parents = 4;
+  const int sample_count = 6;
+  const int num_loci = 70;
+  struct gtype_type *females[2], *males[2];
+  struct gtype_type sample[sample_count];
+  struct pedigree ped;
+  int j, l;
+
+  parseWithoutMutation();
+  allocateGenerationBuffers(females, males, parents, num_loci);
+  allocatePedigree(&ped, 0, parents, sample_count);
+  for(j = 0; j < sample_count; j++){
+    sample[j].pgtype = (ALLELE_TYPE *)malloc(num_loci * sizeof(ALLELE_TYPE));
+    sample[j].mgtype = (ALLELE_TYPE *)malloc(num_loci * sizeof(ALLELE_TYPE));
+  }
+  // Label every founder allele with its individual
+  for(j = 0; j < parents; j++){
+    for(l = 0; l < num_loci; l++){
+      females[0][j].pgtype[l] = 4 * j + 1;
+      females[0][j].mgtype[l] = 4 * j + 2;
+      males[0][j].pgtype[l] = 4 * j + 3;
+      males[0][j].mgtype[l] = 4 * j + 4;
+    }
+  }
+
+  useRandomStream(0, RANDOM_SUBSTREAM_SIMULATION);
+  drawPedigree(&ped, 0, parents, sample_count);
+  dropPedigreeLoci(&ped, females, males, sample, 0, 0, 30);
+  dropPedigreeLoci(&ped, females, males, sample, 0, 30, num_loci);
+
+  for(j = 0; j < sample_count; j++){
+    int mother = pedigreeMothers(&ped, pedigreeSampleBrood(&ped))[j];
+    int father = pedigreeFathers(&ped, pedigreeSampleBrood(&ped))[j];
+    for(l = 0; l < num_loci; l++){
+      EXPECT_TRUE(sample[j].mgtype[l] == 4 * mother + 1 || sample[j].mgtype[l] == 4 * mother + 2);
+      EXPECT_TRUE(sample[j].pgtype[l] == 4 * father + 3 || sample[j].pgtype[l] == 4 * father + 4);
+    }
+  }
+
+  for(j = 0; j < sample_count; j++){
+    free(sample[j].pgtype);
+    free(sample[j].mgtype);
+  }
+  deallocatePedigree(&ped);
+  deallocateGenerationBuffers(females, males, parents);
+  flushArguments();
+}
+
+// A checkpoint pedigree breeds a sample from every generation from the first
+// checkpoint on, written earliest first; the sample bred from the founders
+// comes from the parents recorded for it, and the generations before the
+// final sample are drawn as without checkpoints.
+TEST(pedigree, checkpoint_samples){
+  const int generations = 2;
+  const int parents = 4;
+  const int sample_count = 6;
+  const int num_loci = 70;
+  struct gtype_type *females[2], *males[2];
+  struct gtype_type sample[(generations + 1) * sample_count];
+  struct pedigree ped, plain;
+  int j, l, g;
+
+  parseWithoutMutation();
+  allocateGenerationBuffers(females, males, parents, num_loci);
+  allocatePedigree(&ped, generations, parents, sample_count);
+  allocatePedigree(&plain, generations, parents, sample_count);
+  for(j = 0; j < (generations + 1) * sample_count; j++){
+    sample[j].pgtype = (ALLELE_TYPE *)malloc(num_loci * sizeof(ALLELE_TYPE));
+    sample[j].mgtype = (ALLELE_TYPE *)malloc(num_loci * sizeof(ALLELE_TYPE));
+  }
+  for(j = 0; j < parents; j++){
+    for(l = 0; l < num_loci; l++){
+      females[0][j].pgtype[l] = 4 * j + 1;
+      females[0][j].mgtype[l] = 4 * j + 2;
+      males[0][j].pgtype[l] = 4 * j + 3;
+      males[0][j].mgtype[l] = 4 * j + 4;
+    }
+  }
+
+  useRandomStream(0, RANDOM_SUBSTREAM_SIMULATION);
+  drawPedigree(&plain, generations, parents, sample_count);
+  useRandomStream(0, RANDOM_SUBSTREAM_SIMULATION);
+  drawCheckpointPedigree(&ped, 0, generations, parents, sample_count);
+  EXPECT_EQ(pedigreeCheckpointCount(&ped), generations + 1);
+  EXPECT_EQ(pedigreeCheckpointBrood(&ped, generations), pedigreeSampleBrood(&ped));
+  for(j = 0; j < sample_count; j++){
+    EXPECT_EQ(pedigreeMothers(&ped, pedigreeSampleBrood(&ped))[j], pedigreeMothers(&plain, pedigreeSampleBrood(&plain))[j]);
+    EXPECT_EQ(pedigreeFathers(&ped, pedigreeSampleBrood(&ped))[j], pedigreeFathers(&plain, pedigreeSampleBrood(&plain))[j]);
+  }
+  // Parents of every checkpoint sample are listed as ancestors
+  for(g = 0; g <= generations; g++){
+    for(j = 0; j < sample_count; j++){
+      int mother = pedigreeMothers(&ped, pedigreeCheckpointBrood(&ped, g))[j];
+      int k, listed = 0;
+      for(k = 0; k < pedigreeAncestorCount(&ped, g, 0); k++) listed |= pedigreeAncestors(&ped, g, 0)[k] == mother;
+      EXPECT_TRUE(listed);
+    }
+  }
+
+  dropPedigreeLoci(&ped, females, males, sample, 0, 0, num_loci);
+  for(j = 0; j < sample_count; j++){
+    int mother = pedigreeMothers(&ped, pedigreeCheckpointBrood(&ped, 0))[j];
+    int father = pedigreeFathers(&ped, pedigreeCheckpointBrood(&ped, 0))[j];
+    for(l = 0; l < num_loci; l++){
+      EXPECT_TRUE(sample[j].mgtype[l] == 4 * mother + 1 || sample[j].mgtype[l] == 4 * mother + 2);
+      EXPECT_TRUE(sample[j].pgtype[l] == 4 * father + 3 || sample[j].pgtype[l] == 4 * father + 4);
+    }
+  }
+  // Later samples still carry founder alleles of the right sex of parent
+  for(j = sample_count; j < (generations + 1) * sample_count; j++){
+    for(l = 0; l < num_loci; l++){
+      EXPECT_GE(sample[j].mgtype[l], 1);
+      EXPECT_LE(sample[j].mgtype[l], 4 * parents);
+    }
+  }
+
+  for(j = 0; j < (generations + 1) * sample_count; j++){
+    free(sample[j].pgtype);
+    free(sample[j].mgtype);
+  }
+  deallocatePedigree(&ped);
+  deallocatePedigree(&plain);
+  deallocateGenerationBuffers(females, males, parents);
+  flushArguments();
+}
@@ -0,0 +1,259 @@
+/*! \file refactor_random.c
+ *  \brief Counter-based pseudorandom number streams for OneSamp.
+ *
+ * The generator is Philox4x32-10 from:
+ *
+ * J. K. Salmon, M. A. Moraes, R. O. Dror, D. E. Shaw, Parallel Random
+ *   Numbers: As Easy as 1, 2, 3, Proceedings of the International Conference
+ *   for High Performance Computing, Networking, Storage and Analysis (SC11),
+ *   2011  [doi>10.1145/2063384.2063405]
+ *
+ * Because every block is a pure function of (seed, iteration, substream,
+ * block number), an iteration draws the same numbers whichever thread
+ * simulates it and in whatever order iterations are scheduled.
+ */
+
+#include "refactor_random.h"
+
+/*! \var struct random_stream current_random_stream
+ *  \brief Stream read by intrand() when counter-based numbers are selected.
+ */
+struct random_stream current_random_stream;
+
+/*! \def PHILOX_M0, PHILOX_M1
+ *  \brief Round multipliers of Philox4x32.
+ */
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+
+/*! \def PHILOX_W0, PHILOX_W1
+ *  \brief Weyl sequence constants that bump the key between rounds.
+ */
+#define PHILOX_W0 0x9E3779B9U
+#define PHILOX_W1 0xBB67AE85U
+
+/*! \def PHILOX_ROUNDS
+ *  \brief Number of rounds of Philox4x32 (10 is the standard choice).
+ */
+#define PHILOX_ROUNDS 10
+
+/*! \brief Computes one block of Philox4x32-10 for the given counter and key.
+ */
+void philox4x32(const unsigned int counter[4], const unsigned int key[2], unsigned int output[4]){
+  unsigned int c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+  unsigned int k0 = key[0], k1 = key[1];
+  int round;
+  for(round = 0; round < PHILOX_ROUNDS; round++){
+    unsigned long long product0 = (unsigned long long) PHILOX_M0 * c0;
+    unsigned long long product1 = (unsigned long long) PHILOX_M1 * c2;
+    c0 = (unsigned int) (product1 >> 32) ^ c1 ^ k0;
+    c1 = (unsigned int) product1;
+    c2 = (unsigned int) (product0 >> 32) ^ c3 ^ k1;
+    c3 = (unsigned int) product0;
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+  output[0] = c0;
+  output[1] = c1;
+  output[2] = c2;
+  output[3] = c3;
+}
+
+/*! \brief Positions a stream at the first block of (seed, iteration, substream).
+ */
+void seedRandomStream(struct random_stream *stream, unsigned long long seed, unsigned int iteration, unsigned int substream){
+  stream->key[0] = (unsigned int) seed;
+  stream->key[1] = (unsigned int) (seed >> 32);
+  stream->counter[0] = 0;
+  stream->counter[1] = 0;
+  stream->counter[2] = iteration;
+  stream->counter[3] = substream;
+  stream->position = 4;
+}
+
+/*! \brief Returns the next 32-bit word of a stream.
+ */
+unsigned int nextRandomStreamWord(struct random_stream *stream){
+  if(stream->position == 4){
+    philox4x32(stream->counter, stream->key, stream->block);
+    if(++stream->counter[0] == 0) ++stream->counter[1];
+    stream->position = 0;
+  }
+  return stream->block[stream->position++];
+}
+
+/*! \brief Fills words[0 .. count - 1] with the next count words of a stream.
+ *
+ * Gives the same words as count calls to nextRandomStreamWord(). Whole
+ * blocks are computed RANDOM_LANES at a time.
+ */
+void fillRandomStreamWords(struct random_stream *stream, unsigned int *words, int count){
+  unsigned int c0[RANDOM_LANES], c1[RANDOM_LANES], c2[RANDOM_LANES], c3[RANDOM_LANES];
+  int filled = 0;
+  int lane, round;
+
+  // Use up the rest of the current block first
+  while(filled < count && stream->position != 4) words[filled++] = nextRandomStreamWord(stream);
+
+  while(count - filled >= 4 * RANDOM_LANES){
+    unsigned int k0 = stream->key[0], k1 = stream->key[1];
+    for(lane = 0; lane < RANDOM_LANES; lane++){
+      c0[lane] = stream->counter[0] + lane;
+      c1[lane] = stream->counter[1] + (c0[lane] < stream->counter[0]);
+      c2[lane] = stream->counter[2];
+      c3[lane] = stream->counter[3];
+    }
+    for(round = 0; round < PHILOX_ROUNDS; round++){
+      for(lane = 0; lane < RANDOM_LANES; lane++){
+        unsigned long long product0 = (unsigned long long) PHILOX_M0 * c0[lane];
+        unsigned long long product1 = (unsigned long long) PHILOX_M1 * c2[lane];
+        c0[lane] = (unsigned int) (product1 >> 32) ^ c1[lane] ^ k0;
+        c1[lane] = (unsigned int) product1;
+        c2[lane] = (unsigned int) (product0 >> 32) ^ c3[lane] ^ k1;
+        c3[lane] = (unsigned int) product0;
+      }
+      k0 += PHILOX_W0;
+      k1 += PHILOX_W1;
+    }
+    for(lane = 0; lane < RANDOM_LANES; lane++){
+      words[filled + 4 * lane] = c0[lane];
+      words[filled + 4 * lane + 1] = c1[lane];
+      words[filled + 4 * lane + 2] = c2[lane];
+      words[filled + 4 * lane + 3] = c3[lane];
+    }
+    filled += 4 * RANDOM_LANES;
+    if(stream->counter[0] + RANDOM_LANES < stream->counter[0]) ++stream->counter[1];
+    stream->counter[0] += RANDOM_LANES;
+  }
+
+  while(filled < count) words[filled++] = nextRandomStreamWord(stream);
+}
+
+/*! \brief Primitive polynomials and initial direction numbers of the Sobol axes after the first.
+ *
+ * Degree s, the coefficients a of the inner terms, and m_1 .. m_s, from the
+ * new-joe-kuo-6.21201 table of:
+ *
+ * S. Joe, F. Y. Kuo, Constructing Sobol sequences with better two-dimensional
+ *   projections, SIAM Journal on Scientific Computing 30 (2008) 2635-2654
+ *   [doi>10.1137/070709359]
+ */
+static const unsigned int sobol_polynomials[DESIGN_AXES - 1][5] = {
+  {1, 0, 1, 0, 0},
+  {2, 1, 1, 3, 0},
+  {3, 1, 1, 3, 1}
+};
+
+/*! \brief Returns coordinate axis of point index of the Sobol sequence, as a 32-bit fraction.
+ *
+ * The first axis is the van der Corput sequence in base 2.
+ */
+unsigned int sobolWord(unsigned int index, int axis){
+  unsigned int directions[32];
+  unsigned int word = 0;
+  int k, i;
+  if(axis == 0){
+    for(k = 0; k < 32; k++) directions[k] = 1U << (31 - k);
+  } else {
+    const unsigned int *polynomial = sobol_polynomials[axis - 1];
+    unsigned int s = polynomial[0];
+    for(k = 0; k < 32; k++){
+      if(k < (int) s){
+        directions[k] = polynomial[2 + k] << (31 - k);
+        continue;
+      }
+      directions[k] = directions[k - s] ^ (directions[k - s] >> s);
+      for(i = 1; i < (int) s; i++){
+        if((polynomial[1] >> (s - 1 - i)) & 1) directions[k] ^= directions[k - i];
+      }
+    }
+  }
+  for(k = 0; index != 0; k++, index >>= 1){
+    if(index & 1) word ^= directions[k];
+  }
+  return word;
+}
+
+/*! \brief Reverses the order of the bits of a word.
+ */
+static unsigned int reverseBits(unsigned int word){
+  word = ((word >> 1) & 0x55555555U) | ((word & 0x55555555U) << 1);
+  word = ((word >> 2) & 0x33333333U) | ((word & 0x33333333U) << 2);
+  word = ((word >> 4) & 0x0F0F0F0FU) | ((word & 0x0F0F0F0FU) << 4);
+  word = ((word >> 8) & 0x00FF00FFU) | ((word & 0x00FF00FFU) << 8);
+  return (word >> 16) | (word << 16);
+}
+
+/*! \brief Applies a random nested uniform (Owen) scramble to a 32-bit fraction.
+ *
+ * Uses the hash of Laine and Karras on the reversed bits, so that each bit is
+ * flipped depending only on the bits above it, from:
+ *
+ * B. Burley, Practical Hash-based Owen Scrambling, Journal of Computer
+ *   Graphics Techniques 9 (2020) 1-20
+ */
+unsigned int scrambleWord(unsigned int word, unsigned int scramble){
+  word = reverseBits(word);
+  word += scramble;
+  word ^= word * 0x6c50b47cU;
+  word ^= word * 0xb82f1e52U;
+  word ^= word * 0xc7afe638U;
+  word ^= word * 0x8d22f6e6U;
+  return reverseBits(word);
+}
+
+/*! \brief Returns the image of index under a random permutation of 0 .. count - 1.
+ *
+ * Hashes within the smallest power of two holding count and walks the cycle
+ * until the result falls below count, from:
+ *
+ * A. Kensler, Correlated Multi-Jittered Sampling, Pixar Technical Memo 13-01
+ *   (2013)
+ */
+unsigned int permuteIndex(unsigned int index, unsigned int count, unsigned int scramble){
+  unsigned int mask = count - 1;
+  mask |= mask >> 1;
+  mask |= mask >> 2;
+  mask |= mask >> 4;
+  mask |= mask >> 8;
+  mask |= mask >> 16;
+  do {
+    index ^= scramble;
+    index *= 0xe170893dU;
+    index ^= scramble >> 16;
+    index ^= (index & mask) >> 4;
+    index ^= scramble >> 8;
+    index *= 0x0929eb3fU;
+    index ^= scramble >> 23;
+    index ^= (index & mask) >> 1;
+    index *= 1 | scramble >> 27;
+    index *= 0x6935fa69U;
+    index ^= (index & mask) >> 11;
+    index *= 0x74dcb303U;
+    index ^= (index & mask) >> 2;
+    index *= 0x9e501cc3U;
+    index ^= (index & mask) >> 2;
+    index *= 0xc860a3dfU;
+    index &= mask;
+    index ^= index >> 5;
+  } while(index >= count);
+  return (index + scramble) % count;
+}
+
+/*! \brief Returns coordinate axis of point index of a design of count points, in [0, 1).
+ *
+ * The scramble of an axis is the first word of its stream at
+ * RANDOM_DESIGN_AXIS, and the jitter of a point within its Latin hypercube
+ * stratum the first word of its stream at its index, both under the design
+ * key. A point thus depends on neither the thread nor the order in which
+ * points are asked for; a Sobol point does not depend on count either.
+ */
+double designPoint(int design, unsigned long long seed, unsigned int index, unsigned int count, int axis){
+  struct random_stream stream;
+  unsigned int scramble;
+  seedRandomStream(&stream, seed ^ RANDOM_DESIGN_KEY, RANDOM_DESIGN_AXIS, axis);
+  scramble = nextRandomStreamWord(&stream);
+  if(design == DESIGN_SOBOL) return scrambleWord(sobolWord(index, axis), scramble) / 4294967296.0;
+  seedRandomStream(&stream, seed ^ RANDOM_DESIGN_KEY, index, axis);
+  return (permuteIndex(index, count, scramble) + nextRandomStreamWord(&stream) / 4294967296.0) / count;
+}
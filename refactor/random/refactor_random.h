@@ -0,0 +1,161 @@
+/*! \file refactor_random.h
+ *  \brief Counter-based pseudorandom number streams for OneSamp.
+ */
+
+#ifndef REFACTOR_RANDOM_H
+#define REFACTOR_RANDOM_H
+
+// Substreams of an iteration. Each parameter draw and the simulation itself
+// read from their own stream, so that none of them depend on how many numbers
+// another one consumed.
+
+/*! \def RANDOM_SUBSTREAM_SIMULATION
+ *  \brief Stream used to simulate the founders and generations of an iteration.
+ */
+#define RANDOM_SUBSTREAM_SIMULATION 0
+
+/*! \def RANDOM_SUBSTREAM_BOTTLENECK
+ *  \brief Stream used to draw the bottleneck size of an iteration.
+ */
+#define RANDOM_SUBSTREAM_BOTTLENECK 1
+
+/*! \def RANDOM_SUBSTREAM_DURATION
+ *  \brief Stream used to draw the bottleneck length of an iteration.
+ */
+#define RANDOM_SUBSTREAM_DURATION 2
+
+/*! \def RANDOM_SUBSTREAM_THETA
+ *  \brief Stream used to draw theta of an iteration.
+ */
+#define RANDOM_SUBSTREAM_THETA 3
+
+/*! \def RANDOM_SUBSTREAM_MUTATION
+ *  \brief Stream used to draw the mutation rate of an iteration.
+ */
+#define RANDOM_SUBSTREAM_MUTATION 4
+
+/*! \def RANDOM_SUBSTREAM_SETUP
+ *  \brief Stream used by work done outside of iterations (input filtering, -g).
+ */
+#define RANDOM_SUBSTREAM_SETUP 5
+
+/*! \def RANDOM_SUBSTREAM_MISSING
+ *  \brief Stream used to copy the missing data pattern of the input into an iteration.
+ */
+#define RANDOM_SUBSTREAM_MISSING 6
+
+/*! \def RANDOM_SUBSTREAM_TILE(first_locus)
+ *  \brief Stream used to simulate the tile of loci of an iteration starting at first_locus.
+ *  Tiles may be simulated by several threads in any order.
+ */
+#define RANDOM_SUBSTREAM_TILE(first_locus) (7 + (first_locus))
+
+/*! \brief State of one counter-based stream.
+ *
+ * The Philox4x32-10 block function maps a 128-bit counter and a 64-bit key to
+ * four random words. The key holds the run seed, and the counter holds the
+ * block number, the iteration and the substream, so any stream can be
+ * recreated from those three values alone.
+ */
+struct random_stream {
+  unsigned int key[2];
+  unsigned int counter[4];
+  unsigned int block[4];
+  int position;
+};
+typedef struct random_stream random_stream;
+
+/*! \def RANDOM_BUFFER_WORDS
+ *  \brief Number of 32-bit words refilled at once by the buffered random API.
+ */
+#define RANDOM_BUFFER_WORDS 256
+
+/*! \def RANDOM_LANES
+ *  \brief Number of Philox blocks computed side by side when filling a buffer.
+ *
+ * The rounds of independent blocks are computed lane by lane, so that the
+ * compiler can map the lanes to SIMD registers.
+ */
+#define RANDOM_LANES 8
+
+/*! \brief Buffer of random words, and a reservoir of single random bits.
+ *
+ * Words are handed out from words[position]. Bits are handed out from the
+ * low bits_left bits of bits, highest first.
+ */
+struct random_buffer {
+  unsigned int words[RANDOM_BUFFER_WORDS];
+  int position;
+  unsigned long long bits;
+  int bits_left;
+};
+typedef struct random_buffer random_buffer;
+
+// Designs of the parameter schedule (-y). Every point of a design is a
+// function of the run seed, the iteration and the parameter (axis) alone.
+
+/*! \def DESIGN_RANDOM
+ *  \brief Parameters of each iteration are drawn independently from its own substreams.
+ */
+#define DESIGN_RANDOM 0
+
+/*! \def DESIGN_SOBOL
+ *  \brief Parameters follow an Owen-scrambled Sobol sequence over the joint box.
+ */
+#define DESIGN_SOBOL 1
+
+/*! \def DESIGN_LATIN_HYPERCUBE
+ *  \brief Parameters follow a Latin hypercube with one stratum per iteration.
+ */
+#define DESIGN_LATIN_HYPERCUBE 2
+
+/*! \def DESIGN_AXES
+ *  \brief Number of axes a design can have (Sobol direction numbers are tabulated for these).
+ */
+#define DESIGN_AXES 4
+
+/*! \def DESIGN_AXIS_BOTTLENECK
+ *  \brief Axis of a design giving the bottleneck size.
+ */
+#define DESIGN_AXIS_BOTTLENECK 0
+
+/*! \def DESIGN_AXIS_DURATION
+ *  \brief Axis of a design giving the bottleneck length.
+ */
+#define DESIGN_AXIS_DURATION 1
+
+/*! \def DESIGN_AXIS_THETA
+ *  \brief Axis of a design giving theta.
+ */
+#define DESIGN_AXIS_THETA 2
+
+/*! \def DESIGN_AXIS_MUTATION
+ *  \brief Axis of a design giving the mutation rate.
+ */
+#define DESIGN_AXIS_MUTATION 3
+
+/*! \def RANDOM_DESIGN_KEY
+ *  \brief Mixed into the run seed to key the words of designs, apart from every stream of the run.
+ */
+#define RANDOM_DESIGN_KEY 0x5DE516A9D0E5C0DEULL
+
+/*! \def RANDOM_DESIGN_AXIS
+ *  \brief Iteration of the design key whose streams hold the scramble of each axis.
+ */
+#define RANDOM_DESIGN_AXIS 0xFFFFFFFFU
+
+void philox4x32(const unsigned int counter[4], const unsigned int key[2], unsigned int output[4]);
+void seedRandomStream(struct random_stream *stream, unsigned long long seed, unsigned int iteration, unsigned int substream);
+unsigned int nextRandomStreamWord(struct random_stream *stream);
+void fillRandomStreamWords(struct random_stream *stream, unsigned int *words, int count);
+unsigned int sobolWord(unsigned int index, int axis);
+unsigned int scrambleWord(unsigned int word, unsigned int scramble);
+unsigned int permuteIndex(unsigned int index, unsigned int count, unsigned int scramble);
+double designPoint(int design, unsigned long long seed, unsigned int index, unsigned int count, int axis);
+
+// Stream read by intrand() when counter-based numbers are selected. Each
+// thread selects the stream of the iteration it is working on.
+extern struct random_stream current_random_stream;
+#pragma omp threadprivate(current_random_stream)
+
+#endif
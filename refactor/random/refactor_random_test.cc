@@ -0,0 +1,154 @@
+#include <gtest/gtest.h>
+#include <string.h>
+
+extern "C"{
+#include "refactor_random.h"
+}
+
+// Known-answer vectors for Philox4x32-10 published with the Random123
+// library (Salmon et al. 2011).
+TEST(random, philox_known_answers){
+  unsigned int output[4];
+
+  const unsigned int counter1[4] = {0, 0, 0, 0};
+  const unsigned int key1[2] = {0, 0};
+  philox4x32(counter1, key1, output);
+  EXPECT_EQ(output[0], 0x6627e8d5U);
+  EXPECT_EQ(output[1], 0xe169c58dU);
+  EXPECT_EQ(output[2], 0xbc57ac4cU);
+  EXPECT_EQ(output[3], 0x9b00dbd8U);
+
+  const unsigned int counter2[4] = {0xffffffffU, 0xffffffffU, 0xffffffffU, 0xffffffffU};
+  const unsigned int key2[2] = {0xffffffffU, 0xffffffffU};
+  philox4x32(counter2, key2, output);
+  EXPECT_EQ(output[0], 0x408f276dU);
+  EXPECT_EQ(output[1], 0x41c83b0eU);
+  EXPECT_EQ(output[2], 0xa20bc7c6U);
+  EXPECT_EQ(output[3], 0x6d5451fdU);
+
+  const unsigned int counter3[4] = {0x243f6a88U, 0x85a308d3U, 0x13198a2eU, 0x03707344U};
+  const unsigned int key3[2] = {0xa4093822U, 0x299f31d0U};
+  philox4x32(counter3, key3, output);
+  EXPECT_EQ(output[0], 0xd16cfe09U);
+  EXPECT_EQ(output[1], 0x94fdccebU);
+  EXPECT_EQ(output[2], 0x5001e420U);
+  EXPECT_EQ(output[3], 0x24126ea1U);
+}
+
+// A stream is a function of (seed, iteration, substream) only, so reseeding
+// replays it and changing any of the three gives different words.
+TEST(random, stream_reproducible){
+  struct random_stream a, b;
+  unsigned int first[10];
+  int i;
+
+  seedRandomStream(&a, 12345, 7, 0);
+  for(i = 0; i < 10; i++) first[i] = nextRandomStreamWord(&a);
+  seedRandomStream(&b, 12345, 7, 0);
+  for(i = 0; i < 10; i++) EXPECT_EQ(first[i], nextRandomStreamWord(&b));
+
+  seedRandomStream(&b, 12345, 8, 0);
+  EXPECT_NE(first[0], nextRandomStreamWord(&b));
+  seedRandomStream(&b, 12345, 7, 1);
+  EXPECT_NE(first[0], nextRandomStreamWord(&b));
+  seedRandomStream(&b, 12346, 7, 0);
+  EXPECT_NE(first[0], nextRandomStreamWord(&b));
+}
+
+// Words come out block by block, in counter order.
+TEST(random, stream_blocks){
+  struct random_stream stream;
+  unsigned int counter[4] = {0, 0, 3, 2};
+  unsigned int key[2] = {99, 0};
+  unsigned int block[4];
+  int i, k;
+
+  seedRandomStream(&stream, 99, 3, 2);
+  for(i = 0; i < 3; i++){
+    counter[0] = i;
+    philox4x32(counter, key, block);
+    for(k = 0; k < 4; k++) EXPECT_EQ(block[k], nextRandomStreamWord(&stream));
+  }
+}
+
+// A bulk fill gives the same words as drawing them one at a time, from any
+// position within a block.
+TEST(random, stream_fill){
+  struct random_stream a, b;
+  unsigned int words[101];
+  int i, offset;
+
+  for(offset = 0; offset < 4; offset++){
+    seedRandomStream(&a, 2014, 5, 1);
+    seedRandomStream(&b, 2014, 5, 1);
+    for(i = 0; i < offset; i++) EXPECT_EQ(nextRandomStreamWord(&a), nextRandomStreamWord(&b));
+    fillRandomStreamWords(&a, words, 101);
+    for(i = 0; i < 101; i++) EXPECT_EQ(words[i], nextRandomStreamWord(&b));
+    EXPECT_EQ(nextRandomStreamWord(&a), nextRandomStreamWord(&b));
+  }
+
+  // Carry from the low counter word into the high one
+  seedRandomStream(&a, 7, 0, 0);
+  seedRandomStream(&b, 7, 0, 0);
+  a.counter[0] = b.counter[0] = 0xfffffffcU;
+  fillRandomStreamWords(&a, words, 64);
+  for(i = 0; i < 64; i++) EXPECT_EQ(words[i], nextRandomStreamWord(&b));
+  EXPECT_EQ(a.counter[1], 1U);
+}
+
+// The unscrambled Sobol axes are (0, 1)-sequences in base 2: each of the
+// first 2^k points falls in its own interval of width 2^-k.
+TEST(random, sobol_stratified){
+  const int k = 6;
+  int axis, i;
+  for(axis = 0; axis < DESIGN_AXES; axis++){
+    int seen[1 << k] = {0};
+    EXPECT_EQ(sobolWord(0, axis), 0U);
+    EXPECT_EQ(sobolWord(1, axis), 0x80000000U);
+    for(i = 0; i < 1 << k; i++) seen[sobolWord(i, axis) >> (32 - k)]++;
+    for(i = 0; i < 1 << k; i++) EXPECT_EQ(seen[i], 1);
+  }
+  // Later axes differ from the first
+  EXPECT_NE(sobolWord(3, 0), sobolWord(3, 2));
+}
+
+// An Owen scramble permutes the intervals of every width, so stratification
+// survives it, and a permuted index is a permutation of 0 .. count - 1.
+TEST(random, scramble_and_permute){
+  const int k = 5;
+  const unsigned int count = 37;
+  int seen[count];
+  unsigned int i;
+
+  memset(seen, 0, sizeof(seen));
+  for(i = 0; i < 1 << k; i++) seen[scrambleWord(sobolWord(i, 1), 0xdeadbeefU) >> (32 - k)]++;
+  for(i = 0; i < 1 << k; i++) EXPECT_EQ(seen[i], 1);
+  EXPECT_NE(scrambleWord(0, 1), scrambleWord(0, 2));
+
+  memset(seen, 0, sizeof(seen));
+  for(i = 0; i < count; i++) seen[permuteIndex(i, count, 12345)]++;
+  for(i = 0; i < count; i++) EXPECT_EQ(seen[i], 1);
+}
+
+// Every axis of a Latin hypercube puts one point in each of count strata, and
+// points depend only on the seed, index, count and axis.
+TEST(random, design_points){
+  const unsigned int count = 50;
+  int seen[count];
+  unsigned int i;
+  int axis;
+
+  for(axis = 0; axis < DESIGN_AXES; axis++){
+    memset(seen, 0, sizeof(seen));
+    for(i = 0; i < count; i++){
+      double point = designPoint(DESIGN_LATIN_HYPERCUBE, 2014, i, count, axis);
+      EXPECT_GE(point, 0.0);
+      EXPECT_LT(point, 1.0);
+      seen[(int) (point * count)]++;
+    }
+    for(i = 0; i < count; i++) EXPECT_EQ(seen[i], 1);
+  }
+  EXPECT_EQ(designPoint(DESIGN_SOBOL, 2014, 17, count, 2), designPoint(DESIGN_SOBOL, 2014, 17, 1000, 2));
+  EXPECT_NE(designPoint(DESIGN_SOBOL, 2014, 17, count, 2), designPoint(DESIGN_SOBOL, 2015, 17, count, 2));
+  EXPECT_NE(designPoint(DESIGN_LATIN_HYPERCUBE, 2014, 3, count, 0), designPoint(DESIGN_LATIN_HYPERCUBE, 2014, 3, count, 1));
+}
@@ -1,5 +1,10 @@
 // Most of this code is verbatim from the original OneSamp
 #include "refactor_stats.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 
 /*! \def fallingQuotient(s, t1, t2, c)
@@ -23,6 +28,111 @@ double allelePr(int val1, int val2, double theta){
   return result;
 }
 
+/*! \def coalescentFrequencies(int num_genes, int min_allele_count, double theta)
+ *  \brief Returns the distribution of the count of the mutant allele among num_genes coalescent genes
+ *  Entry j of the returned array (which the caller frees) is the probability
+ *  of j + min_allele_count mutant genes, for j up to num_genes / 2 - min_allele_count.
+ */
+double *coalescentFrequencies(int num_genes, int min_allele_count, double theta){
+  double *table = (double *)malloc((num_genes / 2 - min_allele_count + 1) * sizeof(double));
+  double total = 0;
+  int j, val1, val2;
+  // Every entry counts num_genes genes, so the falling quotient of allelePr(),
+  // which only depends on that total, is common to all of them and cancels
+  // out below. Leaving it out keeps the table linear in num_genes.
+  for(j = 0; j <= num_genes / 2 - min_allele_count; j++){
+    val1 = j + min_allele_count;
+    val2 = num_genes - val1;
+    table[j] = (val1 != 0 ? theta / val1 : 1.0) * (val2 != 0 ? theta / val2 : 1.0);
+    if(val1 == val2) table[j] /= 2;
+    total += table[j];
+  }
+  for(j = 0; j <= num_genes / 2 - min_allele_count; j++){
+    table[j] /= total;
+  }
+  return table;
+}
+
+/*! \brief Sets up an empty founder table.
+ */
+void allocateFounderTable(struct founder_table *table){
+  table->num_genes = -1;
+  table->min_allele_count = -1;
+  table->theta = -1;
+  table->size = 0;
+  table->allocation = 0;
+  table->threshold = NULL;
+  table->alias = NULL;
+}
+
+/*! \brief Deallocates a founder table.
+ */
+void deallocateFounderTable(struct founder_table *table){
+  free(table->threshold);
+  free(table->alias);
+  allocateFounderTable(table);
+}
+
+/*! \brief Sets table to the distribution of coalescentFrequencies(), unless it already holds it.
+ *
+ * With at least one mutant gene, theta scales every entry of the distribution
+ * alike, so it does not change the table. Otherwise the entry without mutant
+ * genes scales differently, and the table is built from theta quantised to
+ * FOUNDER_THETA_STEPS steps per factor of ten, so that it only depends on the
+ * step. The alias columns are paired up by Vose's method: each column short
+ * of the mean probability is topped up from one over it.
+ */
+void prepareFounderTable(struct founder_table *table, int num_genes, int min_allele_count, double theta){
+  double *probability;
+  int *small, *large;
+  int num_small = 0, num_large = 0;
+  int j, s, l;
+  if(min_allele_count > 0) theta = 1;
+  else if(theta > 0) theta = pow(10, floor(log10(theta) * FOUNDER_THETA_STEPS + 0.5) / FOUNDER_THETA_STEPS);
+  if(table->num_genes == num_genes && table->min_allele_count == min_allele_count && table->theta == theta) return;
+  probability = coalescentFrequencies(num_genes, min_allele_count, theta);
+  table->num_genes = num_genes;
+  table->min_allele_count = min_allele_count;
+  table->theta = theta;
+  table->size = num_genes / 2 - min_allele_count + 1;
+  if(table->size > table->allocation){
+    table->allocation = table->size;
+    table->threshold = (double *)realloc(table->threshold, table->allocation * sizeof(double));
+    table->alias = (int *)realloc(table->alias, table->allocation * sizeof(int));
+  }
+  small = (int *)malloc(table->size * sizeof(int));
+  large = (int *)malloc(table->size * sizeof(int));
+  for(j = 0; j < table->size; j++){
+    table->threshold[j] = probability[j] * table->size;
+    table->alias[j] = j;
+    if(table->threshold[j] < 1) small[num_small++] = j;
+    else large[num_large++] = j;
+  }
+  while(num_small > 0 && num_large > 0){
+    s = small[--num_small];
+    l = large[num_large - 1];
+    table->alias[s] = l;
+    table->threshold[l] -= 1 - table->threshold[s];
+    if(table->threshold[l] < 1){
+      num_large--;
+      small[num_small++] = l;
+    }
+  }
+  // Whatever is left over is off 1 by rounding only
+  while(num_large > 0) table->threshold[large[--num_large]] = 1;
+  while(num_small > 0) table->threshold[small[--num_small]] = 1;
+  free(small);
+  free(large);
+  free(probability);
+}
+
+/*! \brief Returns a mutant allele count drawn from a founder table, in constant time.
+ */
+int drawFounderCount(const struct founder_table *table){
+  int column = randomBounded(table->size);
+  return table->min_allele_count + (randomUniform() < table->threshold[column] ? column : table->alias[column]);
+}
+
 /*! \def minAlleleCount()
  *  \brief Returns minimum number of mutated alleles in coalescent sample
  */
@@ -34,85 +144,251 @@ int minAlleleCount(){
  *  \brief Mutates the given gene based on whether it is a microsat or SNP
  */
 void mutate(ALLELE_TYPE *gene, int motif){
-  if(parseFormFlag() != 1) { mutateSNP(gene); } else { mutateMicroSat(gene, motif); }
+  if(run_config.form_flag != 1) { mutateSNP(gene); } else { mutateMicroSat(gene, motif); }
 }
 
 /*! \def mutateSNP(ALLELE_TYPE *gene)
  *  \brief Mutates a SNP
  */
 void mutateSNP(ALLELE_TYPE *gene){
-  *gene = 2 * randBit() + randBit() + 1;
+  *gene = randomBounded(4) + 1;
 }
 
 /*! \def mutateMicroSat(ALLELE_TYPE *gene)
  *  \brief Mutates a microsatellite
  */
 void mutateMicroSat(ALLELE_TYPE *gene, int motif){
-  if(*gene != 0) *gene += randBit() ? motif : -motif; // Random increase or decrease in microsat length.
+  if(*gene != 0) *gene += randomBit() ? motif : -motif; // Random increase or decrease in microsat length.
   if(*gene < 12) *gene = 12;
   if(*gene > 996) *gene = 996;
 }
 
+/*! \def driftAlleleCounts(ALLELE_TYPE *alleles, int *counts, int num_alleles, int num_genes, int generations, int samp, int motif)
+ *  \brief Carries the allele counts of one locus through generations of a gene pool of num_genes genes
+ *
+ * Each generation draws num_genes genes from the last one, a multinomial
+ * draw done as a chain of binomials, then mutates genes with the mutation rate
+ * of iteration samp. Counts of alleles[0 .. num_alleles - 1] are updated in
+ * place, lost alleles are dropped, and new ones are appended; the number of
+ * alleles left is returned. Both arrays hold DRIFT_MAX_ALLELES entries.
+ */
+int driftAlleleCounts(ALLELE_TYPE *alleles, int *counts, int num_alleles, int num_genes, int generations, int samp, int motif)
+{
+  double mutationRate = parseMRate(samp);
+  int g,a,b,k,left,weight,drawn,mutations,gene,kept;
+  ALLELE_TYPE allele;
+  for(g = 0; g < generations; ++g){
+    // Resample the genes
+    left = num_genes;
+    weight = num_genes;
+    for(a = 0; a < num_alleles; ++a){
+      drawn = a == num_alleles - 1 ? left : randomBinomial(left, (double) counts[a] / weight);
+      weight -= counts[a];
+      counts[a] = drawn;
+      left -= drawn;
+    }
+    // Mutate random genes
+    mutations = randomBinomial(num_genes, mutationRate);
+    for(k = 0; k < mutations; ++k){
+      gene = randomBounded(num_genes);
+      for(a = 0; gene >= counts[a]; ++a) gene -= counts[a];
+      allele = alleles[a];
+      mutate(&allele, motif);
+      for(b = 0; b < num_alleles && alleles[b] != allele; ++b);
+      if(b == num_alleles){
+        if(num_alleles == DRIFT_MAX_ALLELES) continue;
+        alleles[b] = allele;
+        counts[b] = 0;
+        ++num_alleles;
+      }
+      --counts[a];
+      ++counts[b];
+    }
+    // Drop lost alleles
+    for(a = 0, kept = 0; a < num_alleles; ++a){
+      if(counts[a] == 0) continue;
+      alleles[kept] = alleles[a];
+      counts[kept] = counts[a];
+      ++kept;
+    }
+    num_alleles = kept;
+  }
+  return num_alleles;
+}
+
 /*! \def assort(int next_gen_count, struct gtype_type *offvec, struct gtype_type *mothers, struct gtype_type *fathers, int current_gen_count)
  *  \brief Generates the next generation of individuals based on the current one
  */
 void assort(int next_gen_count, struct gtype_type *offvec, struct gtype_type *mothers, struct gtype_type *fathers, int current_gen_count, int samp, int num_loci)
+{
+  int *mother_index = (int *)malloc(next_gen_count * sizeof(int));
+  int *father_index = (int *)malloc(next_gen_count * sizeof(int));
+  int j;
+  // Select random mother and father from current generation
+  for(j = 0; j < next_gen_count; ++j){
+    mother_index[j] = randomBounded(current_gen_count);
+    father_index[j] = randomBounded(current_gen_count);
+  }
+  assortLoci(next_gen_count, offvec, mothers, fathers, mother_index, father_index, NULL, samp, 0, num_loci);
+  free(mother_index);
+  free(father_index);
+}
+
+/*! \brief Gathers the even bits of a word: bit 2k of bits becomes bit k.
+ */
+static inline unsigned int evenBits(unsigned long long bits){
+  bits &= 0x5555555555555555ULL;
+  bits = (bits | bits >> 1) & 0x3333333333333333ULL;
+  bits = (bits | bits >> 2) & 0x0F0F0F0F0F0F0F0FULL;
+  bits = (bits | bits >> 4) & 0x00FF00FF00FF00FFULL;
+  bits = (bits | bits >> 8) & 0x0000FFFF0000FFFFULL;
+  bits = (bits | bits >> 16) & 0x00000000FFFFFFFFULL;
+  return (unsigned int) bits;
+}
+
+/*! \brief Copies allele k of set to out if bit k of mask is set, and of clear otherwise, for count alleles.
+ */
+void blendAllelesScalar(ALLELE_TYPE *out, const ALLELE_TYPE *set, const ALLELE_TYPE *clear, unsigned int mask, int count){
+  int k;
+  for(k = 0; k < count; k++, mask >>= 1) out[k] = mask & 1 ? set[k] : clear[k];
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/*! \brief Blends alleles as blendAllelesScalar(), 16 lanes at a time with AVX2.
+ *
+ * Each lane of a broadcast mask keeps its own bit, which a compare turns into
+ * a byte mask for the blend.
+ */
+__attribute__((target("avx2")))
+static void blendAllelesAVX2(ALLELE_TYPE *out, const ALLELE_TYPE *set, const ALLELE_TYPE *clear, unsigned int mask, int count){
+  const __m256i lanes = _mm256_setr_epi16(0x0001, 0x0002, 0x0004, 0x0008, 0x0010, 0x0020, 0x0040, 0x0080, 0x0100, 0x0200, 0x0400, 0x0800, 0x1000, 0x2000, 0x4000, (short) 0x8000);
+  int k;
+  for(k = 0; k + 16 <= count; k += 16, mask >>= 16){
+    __m256i chosen = _mm256_set1_epi16((short) (mask & 0xFFFF));
+    chosen = _mm256_cmpeq_epi16(_mm256_and_si256(chosen, lanes), lanes);
+    _mm256_storeu_si256((__m256i *) (out + k), _mm256_blendv_epi8(_mm256_loadu_si256((const __m256i *) (clear + k)), _mm256_loadu_si256((const __m256i *) (set + k)), chosen));
+  }
+  blendAllelesScalar(out + k, set + k, clear + k, mask, count - k);
+}
+#elif defined(__ARM_NEON)
+/*! \brief Blends alleles as blendAllelesScalar(), 8 lanes at a time with NEON.
+ */
+static void blendAllelesNEON(ALLELE_TYPE *out, const ALLELE_TYPE *set, const ALLELE_TYPE *clear, unsigned int mask, int count){
+  static const unsigned short bit_values[8] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
+  const uint16x8_t lanes = vld1q_u16(bit_values);
+  int k;
+  for(k = 0; k + 8 <= count; k += 8, mask >>= 8){
+    uint16x8_t chosen = vtstq_u16(vdupq_n_u16((unsigned short) (mask & 0xFF)), lanes);
+    vst1q_s16(out + k, vbslq_s16(chosen, vld1q_s16(set + k), vld1q_s16(clear + k)));
+  }
+  blendAllelesScalar(out + k, set + k, clear + k, mask, count - k);
+}
+#endif
+
+/*! \brief Blends alleles as blendAllelesScalar(), with the widest kernel the CPU supports.
+ *
+ * The kernel is chosen at run time, so one binary runs on any CPU of its
+ * architecture. All kernels give the same alleles.
+ */
+void blendAlleles(ALLELE_TYPE *out, const ALLELE_TYPE *set, const ALLELE_TYPE *clear, unsigned int mask, int count){
+#if defined(__x86_64__) || defined(__i386__)
+  if(sizeof(ALLELE_TYPE) == 2 && __builtin_cpu_supports("avx2")){
+    blendAllelesAVX2(out, set, clear, mask, count);
+    return;
+  }
+#elif defined(__ARM_NEON)
+  if(sizeof(ALLELE_TYPE) == 2){
+    blendAllelesNEON(out, set, clear, mask, count);
+    return;
+  }
+#endif
+  blendAllelesScalar(out, set, clear, mask, count);
+}
+
+/*! \def assortLoci(int next_gen_count, struct gtype_type *offvec, struct gtype_type *mothers, struct gtype_type *fathers, const int *mother_index, const int *father_index, const int *offspring, int samp, int first_locus, int last_locus)
+ *  \brief Generates loci first_locus to last_locus - 1 of the next generation from chosen parents
+ *
+ * Offspring j gets one allele of mothers[mother_index[j]] and one of
+ * fathers[father_index[j]] at each locus, so loci simulated in separate calls
+ * with the same parents share one pedigree. If offspring is not NULL, only the
+ * next_gen_count offspring it lists are generated; otherwise offspring 0 to
+ * next_gen_count - 1 are.
+ */
+void assortLoci(int next_gen_count, struct gtype_type *offvec, struct gtype_type *mothers, struct gtype_type *fathers, const int *mother_index, const int *father_index, const int *offspring, int samp, int first_locus, int last_locus)
 {
   // Read in mutation rate
-  int pMutation = parseMRate(samp);
-  // Read in number of loci
-  int j,i,m,d;
+  double logNoMutation = log1p(-parseMRate(samp));
+  int num_loci = last_locus - first_locus;
+  long long alleles = 2LL * next_gen_count * num_loci;
+  long long allele;
+  int j,i,m,d,o,block_end;
+  unsigned long long bits;
   // Simulate each individual's genotype
-  for(j = 0; j < next_gen_count; ++j){
-    // Select random mother from current generation
-    m = disrand(0,current_gen_count-1);
-    // Select random father from current generation
-    d = disrand(0,current_gen_count-1);
-    // For each allele, select one from parent and possibly mutate
-    for(i = 0; i < num_loci; ++i){
-      // Generate a new individual
-      offvec[j].mgtype[i] = randBit() ? mothers[m].mgtype[i] : mothers[m].pgtype[i];
-      if(branchWithProbability(pMutation)) mutate(offvec[j].mgtype + i, parseFormFlag() != 1 ? 0 : getMotifLengths()[i]);
-      // Generate a new individual
-      offvec[j].pgtype[i] = randBit() ? fathers[d].mgtype[i] : fathers[d].pgtype[i];
-      if(branchWithProbability(pMutation)) mutate(offvec[j].pgtype + i, parseFormFlag() != 1 ? 0 : getMotifLengths()[i]);
+  for(o = 0; o < next_gen_count; ++o){
+    j = offspring == NULL ? o : offspring[o];
+    m = mother_index[j];
+    d = father_index[j];
+    // For each allele, select one from parent: a random word decides both
+    // alleles of 32 loci, its even bits from the mother and odd bits from
+    // the father
+    for(i = first_locus; i < last_locus; i = block_end){
+      block_end = i + 32 < last_locus ? i + 32 : last_locus;
+      bits = randomWord64();
+      blendAlleles(offvec[j].mgtype + i, mothers[m].mgtype + i, mothers[m].pgtype + i, evenBits(bits), block_end - i);
+      blendAlleles(offvec[j].pgtype + i, fathers[d].mgtype + i, fathers[d].pgtype + i, evenBits(bits >> 1), block_end - i);
     }
   }
+  // Mutate: alleles are numbered (individual, locus, maternal/paternal), and
+  // the gaps between mutated ones are drawn directly.
+  for(allele = randomGeometricSkip(logNoMutation); allele < alleles; allele += 1 + randomGeometricSkip(logNoMutation)){
+    o = allele / (2 * num_loci);
+    j = offspring == NULL ? o : offspring[o];
+    i = first_locus + (allele / 2) % num_loci;
+    mutate((allele % 2 == 0 ? offvec[j].mgtype : offvec[j].pgtype) + i, run_config.form_flag != 1 ? 0 : getMotifLengths()[i]);
+  }
 }
 
-/*! \def sortM(int **numberOfAlleles, int num_samples, double m[], int ***gType, int ****gcountPtr)
- *  \brief computes allele length divided by allele length range (doesn't work for SNPs)
+/*! \def sortMAssist(int **numberOfAlleles, int num_samples, double m[], int ***gType, int ****gcountPtr, int samp)
+ *  \brief computes allele length divided by allele length range of one sample (doesn't work for SNPs)
  */
-void sortM(int **numberOfAlleles, int num_samples, double m[], int ***gType, int ****gcountPtr)
+void sortMAssist(int **numberOfAlleles, int num_samples, double m[], int ***gType, int ****gcountPtr, int samp)
 {
   int ***gcount = *gcountPtr;
-  int numloci = parseNLoci();
+  int numloci = run_config.num_loci;
   int i,h,iloc,r,s,skip,mono;
   double Msum,M;
+  if(run_config.form_flag != 1){m[samp] = -1; return; }
+  Msum = 0.0;
+  M = 0.0;
+  mono = 0;
+  for(iloc=0;iloc<numloci;++iloc){
+    skip = 0;
+    r = 1;
+    s = 0;
+      for(i=0;i<(numberOfAlleles[samp][iloc]-1);++i){
+        for(h=i+1;h<numberOfAlleles[samp][iloc];++h){
+          s = abs(gType[samp][iloc][i] - gType[samp][iloc][h]) + 1;
+          if ((r < s) && (gcount[samp][iloc][i] > 0) && (gcount[samp][iloc][h] > 0)) r = s;
+        }
+      }
+      for(i=0;i<numberOfAlleles[samp][iloc];++i) {
+        if(gcount[samp][iloc][i] == 0) ++skip;
+      }
+    if(r==1) {++mono;continue;}
+    Msum += (double)(numberOfAlleles[samp][iloc] - skip) / r;
+  }
+  if(mono == numloci) {m[samp] = 0.0; return;}
+  m[samp] = Msum /((double) numloci - mono);
+}
+
+/*! \def sortM(int **numberOfAlleles, int num_samples, double m[], int ***gType, int ****gcountPtr)
+ *  \brief computes allele length divided by allele length range (doesn't work for SNPs)
+ */
+void sortM(int **numberOfAlleles, int num_samples, double m[], int ***gType, int ****gcountPtr)
+{
   int samp;
   for(samp=0;samp<num_samples;++samp){
-    if(parseFormFlag() != 1){m[samp] = -1; continue; }
-    Msum = 0.0;
-    M = 0.0;
-    mono = 0;
-    for(iloc=0;iloc<numloci;++iloc){
-      skip = 0;
-      r = 1;
-      s = 0;
-        for(i=0;i<(numberOfAlleles[samp][iloc]-1);++i){
-          for(h=i+1;h<numberOfAlleles[samp][iloc];++h){
-            s = abs(gType[samp][iloc][i] - gType[samp][iloc][h]) + 1;
-            if ((r < s) && (gcount[samp][iloc][i] > 0) && (gcount[samp][iloc][h] > 0)) r = s;
-          }
-        }
-        for(i=0;i<numberOfAlleles[samp][iloc];++i) {
-          if(gcount[samp][iloc][i] == 0) ++skip;
-        }
-      if(r==1) {++mono;continue;}
-      Msum += (double)(numberOfAlleles[samp][iloc] - skip) / r;
-    }
-    if(mono == numloci) {m[samp] = 0.0; continue;}
-    m[samp] = Msum /((double) numloci - mono);
+    sortMAssist(numberOfAlleles, num_samples, m, gType, gcountPtr, samp);
   }
 }
 
@@ -165,11 +441,13 @@ void twolocusiisAssist(int **numberOfAlleles, int num_samples, struct gtype_type
   double r;
   double sampCorrection;
   double result = 0;
+  int numloci = run_config.num_loci;
+  int final_indivs_count = run_config.input_samples;
   #pragma omp parallel for private(jloc, alprs, al1, al2, psq1obs, psq2obs, cnt, ofreq1, ofreq2, ind, doublesum, curIndex, miData, mjData, piData, pjData, gi1, gj2, dcnt, p1, p2, jointAB, d1, d2, sqrtFactor1, sqrtFactor2, r_intermediate, r, sampCorrection)
-  for(iloc = 0; iloc < parseNLoci(); iloc++){
+  for(iloc = 0; iloc < numloci; iloc++){
     // Index of locus j
     int jloc;
-    for(jloc = iloc + 1; jloc < parseNLoci(); jloc++){
+    for(jloc = iloc + 1; jloc < numloci; jloc++){
       progress++;
       // Count of number of allele pairs
       int alprs = 0;
@@ -178,7 +456,9 @@ void twolocusiisAssist(int **numberOfAlleles, int num_samples, struct gtype_type
       for(al1 = 0; al1 < numberOfAlleles[samp][iloc]; al1++){
         // Index of allele 2
         int al2;
+        gi1 = gType[samp][iloc][al1];
         for(al2 = 0; al2 < numberOfAlleles[samp][jloc]; al2++){
+          gj2 = gType[samp][jloc][al2];
           // Observed count of homozygotes in first locus
           psq1obs = 0;
           // Observed count of homozygotes in second locus
@@ -193,14 +473,12 @@ void twolocusiisAssist(int **numberOfAlleles, int num_samples, struct gtype_type
           // ind;
           // Count of matches pairs of genotypes
           doublesum = 0;
-          for(ind = 0; ind < parseInputSamples(); ind++){
+          for(ind = 0; ind < final_indivs_count; ind++){
             curIndex = samp_data[samp][ind];
             miData = curIndex.mgtype[iloc];
             mjData = curIndex.mgtype[jloc];
             piData = curIndex.pgtype[iloc];
             pjData = curIndex.pgtype[jloc];
-            gi1 = gType[samp][iloc][al1];
-            gj2 = gType[samp][jloc][al2];
             #define miMatch (miData == gi1)
             #define mjMatch (mjData == gj2)
             #define piMatch (piData == gi1)
@@ -314,44 +592,53 @@ void twolocusiis(int **numberOfAlleles, int num_samples, struct gtype_type **sam
 
 // STATISTIC 3: lnbeta: imbalance in allele lengths
 
-/*! \def beta(int **numberOfAlleles, int num_samples, double lnbeta[], int ***gType, int ****gcountPtr)
- *  \brief computes imbalance in allele lengths (no SNPs)
+/*! \def betaAssist(int **numberOfAlleles, int num_samples, double lnbeta[], int ***gType, int ****gcountPtr, int samp)
+ *  \brief computes imbalance in allele lengths of one sample (no SNPs)
  */
-void beta(int **numberOfAlleles, int num_samples, double lnbeta[], int ***gType, int ****gcountPtr)
+void betaAssist(int **numberOfAlleles, int num_samples, double lnbeta[], int ***gType, int ****gcountPtr, int samp)
 {
-  int final_indivs_count = parseInputSamples();
+  int final_indivs_count = run_config.input_samples;
   int ***gcount = *gcountPtr;
-  int numloci = parseNLoci();
-  int samp,iloc,kal,skip;
+  int numloci = run_config.num_loci;
+  int iloc,kal,skip;
   double psq,sumlen,meanlen,po,varlen,cvarlen,cvarpo,beta;
-  for(samp=0;samp<num_samples;++samp) {
-    if(parseFormFlag() != 1) {lnbeta[samp] = -1; continue;}
-    beta = 0.0;
-    skip = 0;
-    for(iloc=0;iloc<numloci;++iloc) {
-      sumlen = psq = cvarpo = cvarlen = varlen = 0.0;
-
-      for(kal=0;kal<numberOfAlleles[samp][iloc];++kal) {
-        if (gcount[samp][iloc][kal] == 0) continue;
-        psq += ((double)gcount[samp][iloc][kal]*gcount[samp][iloc][kal])/((double)4 * final_indivs_count * final_indivs_count);
-        sumlen += gcount[samp][iloc][kal]*gType[samp][iloc][kal];
-      }
+  if(run_config.form_flag != 1) {lnbeta[samp] = -1; return;}
+  beta = 0.0;
+  skip = 0;
+  for(iloc=0;iloc<numloci;++iloc) {
+    sumlen = psq = cvarpo = cvarlen = varlen = 0.0;
+
+    for(kal=0;kal<numberOfAlleles[samp][iloc];++kal) {
+      if (gcount[samp][iloc][kal] == 0) continue;
+      psq += ((double)gcount[samp][iloc][kal]*gcount[samp][iloc][kal])/((double)4 * final_indivs_count * final_indivs_count);
+      sumlen += gcount[samp][iloc][kal]*gType[samp][iloc][kal];
+    }
 
-      if (psq == 1.0) {++skip; continue;}
+    if (psq == 1.0) {++skip; continue;}
 
-      meanlen = (sumlen/(2 * final_indivs_count));
-      po = (psq * 2 * final_indivs_count-1)/(2 * final_indivs_count-1);
+    meanlen = (sumlen/(2 * final_indivs_count));
+    po = (psq * 2 * final_indivs_count-1)/(2 * final_indivs_count-1);
 
-      for(kal=0;kal<numberOfAlleles[samp][iloc];++kal) {
-      varlen += gcount[samp][iloc][kal]*((gType[samp][iloc][kal]-meanlen)*(gType[samp][iloc][kal]-meanlen));
-      }
-
-      cvarlen = 2.0*varlen/(2*final_indivs_count-1);
-      cvarpo = ((1/(po*po))-1)/2.0;
-      beta += (log(cvarlen)-log(cvarpo));
+    for(kal=0;kal<numberOfAlleles[samp][iloc];++kal) {
+    varlen += gcount[samp][iloc][kal]*((gType[samp][iloc][kal]-meanlen)*(gType[samp][iloc][kal]-meanlen));
     }
-  if(numloci == skip) {lnbeta[samp] = 0.0; continue;}
+
+    cvarlen = 2.0*varlen/(2*final_indivs_count-1);
+    cvarpo = ((1/(po*po))-1)/2.0;
+    beta += (log(cvarlen)-log(cvarpo));
+  }
+  if(numloci == skip) {lnbeta[samp] = 0.0; return;}
   lnbeta[samp] = beta/(numloci-skip);
+}
+
+/*! \def beta(int **numberOfAlleles, int num_samples, double lnbeta[], int ***gType, int ****gcountPtr)
+ *  \brief computes imbalance in allele lengths (no SNPs)
+ */
+void beta(int **numberOfAlleles, int num_samples, double lnbeta[], int ***gType, int ****gcountPtr)
+{
+  int samp;
+  for(samp=0;samp<num_samples;++samp) {
+    betaAssist(numberOfAlleles, num_samples, lnbeta, gType, gcountPtr, samp);
   }
 }
 
@@ -359,134 +646,167 @@ void beta(int **numberOfAlleles, int num_samples, double lnbeta[], int ***gType,
 // STATISTIC 5: mnehet: expected mean heterozygosity: SNPs okay, formula is unchanged
 // The unbiased sample statistic is from the Nei 1987 source.
 
-/*! \def hetexcess(int **numberOfAlleles,int num_samples, struct gtype_type **samp_data, double *hetx, double *mnehet, int ***gType, int ****gcountPtr)
- *  \brief computes excess heterozygosity statistics
+/*! \def hetexcessAssist(int **numberOfAlleles,int num_samples, struct gtype_type **samp_data, double *hetx, double *mnehet, int ***gType, int ****gcountPtr, int samp)
+ *  \brief computes excess heterozygosity statistics of one sample
  */
-void hetexcess(int **numberOfAlleles,int num_samples, struct gtype_type **samp_data, double *hetx, double *mnehet, int ***gType, int ****gcountPtr)
+void hetexcessAssist(int **numberOfAlleles,int num_samples, struct gtype_type **samp_data, double *hetx, double *mnehet, int ***gType, int ****gcountPtr, int samp)
 {
   int ***gcount = *gcountPtr;
-  int numloci = parseNLoci();
-  int final_indivs_count = parseInputSamples();
+  int numloci = run_config.num_loci;
+  int final_indivs_count = run_config.input_samples;
   int iloc, al1, dblp, ind, skipind, nonzeroindices, skiploc;
   double sumhobs, sumhexp, obshomo, exphomo;
 
+  sumhobs = sumhexp = skiploc = 0;
+  for(iloc = 0; iloc < numloci; iloc++) {
+    obshomo = exphomo = nonzeroindices = 0;
+    dblp = 0;
+    skipind = 0;
+    for(ind = 0; ind < final_indivs_count; ind++) {
+      if((samp_data[samp][ind].mgtype[iloc] == 0) || (samp_data[samp][ind].pgtype[iloc] == 0)) ++skipind;
+      else if(samp_data[samp][ind].mgtype[iloc] == samp_data[samp][ind].pgtype[iloc]) ++dblp; // Count of homozygotes
+    }
+    ind -= skipind; // ind now counts number of legal pairs
+    obshomo += (double)dblp / ind; // Frequency of homozygotes
+    for(al1 = 0; al1 < numberOfAlleles[samp][iloc]; al1++) {
+      if(gType[samp][iloc][al1] == 0){ continue; }
+      nonzeroindices += gcount[samp][iloc][al1];
+      exphomo += gcount[samp][iloc][al1] * gcount[samp][iloc][al1]; // Expected frequency of homozygotes
+    } // als per locus
+
+    if(nonzeroindices == 0 || ind == 0 || numberOfAlleles[samp][iloc] == 1 || (numberOfAlleles[samp][iloc] == 2 && (gType[samp][iloc][0] == 0 || gType[samp][iloc][1] == 0))) { skiploc++; continue; } // Number of heterozygotes is undefined or monoallelic site.
+    exphomo /= nonzeroindices * nonzeroindices;
+    double observedHeterozygoteFrequency = 1 - obshomo;
+    double expectedHeterozygoteFrequency = 1 - exphomo;
+    // printf("iloc = %d\nobservedH = %f\n", iloc, observedHeterozygoteFrequency);
+    // printf("expectedH = %f\n",expectedHeterozygoteFrequency);
+    double sampleCorrectionFactor = ((double) ind) / (ind - 1);
+    sumhobs += observedHeterozygoteFrequency; // Accumulate actual frequencies of heterozygotes
+
+    double samplehexp = sampleCorrectionFactor * (expectedHeterozygoteFrequency - observedHeterozygoteFrequency/(2*ind));
+
+    // Bounds check
+    if(!(samplehexp > 0)) samplehexp = 0;
+    if(!(samplehexp < 1)) samplehexp = 1;
+
+    sumhexp += samplehexp; // Accumulate expected frequencies of heterozygotes
+  } // loci
+  mnehet[samp] = sumhexp / (double) (numloci - skiploc);
+
+  //if(mnehet[samp] != mnehet[samp]) {
+  //  printf("Illegal mean NEHET\n"); writeoutput(samp_data);
+  //}
+
+  hetx[samp] = (sumhexp == 0) ? 1/0.0 : 1 - sumhobs / sumhexp;
+
+  //if(hetx[samp] != hetx[samp]) {
+  //  printf("Illegal excess het\n"); writeoutput(samp_data);
+  //}
+}
+
+/*! \def hetexcess(int **numberOfAlleles,int num_samples, struct gtype_type **samp_data, double *hetx, double *mnehet, int ***gType, int ****gcountPtr)
+ *  \brief computes excess heterozygosity statistics
+ */
+void hetexcess(int **numberOfAlleles,int num_samples, struct gtype_type **samp_data, double *hetx, double *mnehet, int ***gType, int ****gcountPtr)
+{
   int samp;
   for(samp = 0; samp < num_samples; samp++){
-    sumhobs = sumhexp = skiploc = 0;
-    for(iloc = 0; iloc < numloci; iloc++) {
-      obshomo = exphomo = nonzeroindices = 0;
-      dblp = 0;
-      skipind = 0;
-      for(ind = 0; ind < final_indivs_count; ind++) {
-        if((samp_data[samp][ind].mgtype[iloc] == 0) || (samp_data[samp][ind].pgtype[iloc] == 0)) ++skipind;
-        else if(samp_data[samp][ind].mgtype[iloc] == samp_data[samp][ind].pgtype[iloc]) ++dblp; // Count of homozygotes
-      }
-      ind -= skipind; // ind now counts number of legal pairs
-      obshomo += (double)dblp / ind; // Frequency of homozygotes
-      for(al1 = 0; al1 < numberOfAlleles[samp][iloc]; al1++) {
-        if(gType[samp][iloc][al1] == 0){ continue; }
-        nonzeroindices += gcount[samp][iloc][al1];
-        exphomo += gcount[samp][iloc][al1] * gcount[samp][iloc][al1]; // Expected frequency of homozygotes
-      } // als per locus
-
-      if(nonzeroindices == 0 || ind == 0 || numberOfAlleles[samp][iloc] == 1 || (numberOfAlleles[samp][iloc] == 2 && (gType[samp][iloc][0] == 0 || gType[samp][iloc][1] == 0))) { skiploc++; continue; } // Number of heterozygotes is undefined or monoallelic site.
-      exphomo /= nonzeroindices * nonzeroindices;
-      double observedHeterozygoteFrequency = 1 - obshomo;
-      double expectedHeterozygoteFrequency = 1 - exphomo;
-      // printf("iloc = %d\nobservedH = %f\n", iloc, observedHeterozygoteFrequency);
-      // printf("expectedH = %f\n",expectedHeterozygoteFrequency);
-      double sampleCorrectionFactor = ((double) ind) / (ind - 1);
-      sumhobs += observedHeterozygoteFrequency; // Accumulate actual frequencies of heterozygotes
-
-      double samplehexp = sampleCorrectionFactor * (expectedHeterozygoteFrequency - observedHeterozygoteFrequency/(2*ind));
-
-      // Bounds check
-      if(!(samplehexp > 0)) samplehexp = 0;
-      if(!(samplehexp < 1)) samplehexp = 1;
-
-      sumhexp += samplehexp; // Accumulate expected frequencies of heterozygotes
-    } // loci
-    mnehet[samp] = sumhexp / (double) (numloci - skiploc);
-
-    //if(mnehet[samp] != mnehet[samp]) {
-    //  printf("Illegal mean NEHET\n"); writeoutput(samp_data);
-    //}
-
-    hetx[samp] = (sumhexp == 0) ? 1/0.0 : 1 - sumhobs / sumhexp;
-
-    //if(hetx[samp] != hetx[samp]) {
-    //  printf("Illegal excess het\n"); writeoutput(samp_data);
-    //}
-
+    hetexcessAssist(numberOfAlleles, num_samples, samp_data, hetx, mnehet, gType, gcountPtr, samp);
   } // samples
 }
 
 // STATISTIC 6: mnals: Compute this statistic first.
 
-/*! \def counts(int ***numberOfAllelesPtr, struct gtype_type **samp_data, double mnals[], int ***gType, int ****gcountPtr)
- *  \brief Generates genotype counts and mean number of allele data
+/*! \def SNP_ALLELE_SLOTS
+ *  \brief Alleles looked up directly when counting SNPs: 0 (missing) and the four bases.
  */
-void counts(int ***numberOfAllelesPtr, struct gtype_type **samp_data, double mnals[], int ***gType, int ****gcountPtr)
+#define SNP_ALLELE_SLOTS 5
+
+/*! \brief Counts the alleles of one locus of a sample, in order of first appearance.
+ *
+ * snp is a constant at every call, so each caller gets its own copy of the
+ * loop: SNP alleles are found through a table of their slots, and other
+ * alleles by searching those seen so far.
+ */
+static inline int countLocusAlleles(struct gtype_type *sample, int count, int locusID, int *type, int *tally, int snp)
+{
+  int slot[SNP_ALLELE_SLOTS] = {-1, -1, -1, -1, -1};
+  int found = 0;
+  int i, j;
+  // Iterate through each individual genes through each pair
+  for(j = 0; j < 2 * count; ++j) {
+    // Current value of allele genotype
+    int val = (j % 2 == 1) ? sample[j / 2].pgtype[locusID] : sample[j / 2].mgtype[locusID];
+    if(snp && val >= 0 && val < SNP_ALLELE_SLOTS){
+      i = slot[val];
+      if(i < 0) slot[val] = i = found;
+    } else {
+      for(i = 0; i < found; ++i) if(val == type[i]) break;
+    }
+    // Create a new index to store information for a new allele
+    if(i == found){
+      tally[i] = 0;
+      type[i] = val;
+      ++found;
+    }
+    ++tally[i];
+  }
+  return found;
+}
+
+/*! \def countsAssist(int ***numberOfAllelesPtr, struct gtype_type **samp_data, double mnals[], int ***gType, int ****gcountPtr, int samp)
+ *  \brief Generates genotype counts and mean number of allele data of one sample
+ */
+void countsAssist(int ***numberOfAllelesPtr, struct gtype_type **samp_data, double mnals[], int ***gType, int ****gcountPtr, int samp)
 {
   int locusID; // Identity of locus
   int i; // Loop index
   int **numberOfAlleles = *numberOfAllelesPtr;
   int ***gcount = *gcountPtr;
-
-  int samp;
-  // For each sample
-  for(samp = 0; samp < parseIterations(); samp++){
-    int p = 0;
-
-    // For each locus
-    for(locusID = 0; locusID < parseNLoci(); ++locusID){
-      numberOfAlleles[samp][locusID] = 0;
-
-      // Iterate through each individual genes through each pair
-      // Apply a counting sort algorithm
-      int j;
-      for(j = 0; j < 2 * parseInputSamples();++j) {
-        // Current individual
-        int indiv = j / 2;
-        // Current value of allele genotype
-        int val = (j % 2 == 1) ? samp_data[samp][indiv].pgtype[locusID] : samp_data[samp][indiv].mgtype[locusID];
-        for(i = 0; i < numberOfAlleles[samp][locusID];++i){
-          if(val == gType[samp][locusID][i]){
-            ++gcount[samp][locusID][i];
-            break;
-          }
-        }
-
-        // Create a new index to store information for a new allele
-        if(i == numberOfAlleles[samp][locusID]){
-          gcount[samp][locusID][i] = 1;
-          gType[samp][locusID][i] = val;
-          ++numberOfAlleles[samp][locusID];
-        }
+  int numloci = run_config.num_loci;
+  int final_indivs_count = run_config.input_samples;
+
+  int p = 0;
+
+  // For each locus
+  for(locusID = 0; locusID < numloci; ++locusID){
+    // Apply a counting sort algorithm, with the variant for the marker type
+    if(run_config.form_flag != 1) numberOfAlleles[samp][locusID] = countLocusAlleles(samp_data[samp], final_indivs_count, locusID, gType[samp][locusID], gcount[samp][locusID], 1);
+    else numberOfAlleles[samp][locusID] = countLocusAlleles(samp_data[samp], final_indivs_count, locusID, gType[samp][locusID], gcount[samp][locusID], 0);
+
+    // Do this only if we have more than one allele at this locus
+    // ???
+    if(numberOfAlleles[samp][locusID] != 1){
+      for(i = 0; i < final_indivs_count; ++i){
+        samp_data[samp][i].pgtype[p] = samp_data[samp][i].pgtype[locusID];
+        samp_data[samp][i].mgtype[p] = samp_data[samp][i].mgtype[locusID];
       }
-
-      // Do this only if we have more than one allele at this locus
-      // ???
-      if(numberOfAlleles[samp][locusID] != 1){
-        for(i = 0; i < parseInputSamples(); ++i){
-          samp_data[samp][i].pgtype[p] = samp_data[samp][i].pgtype[locusID];
-          samp_data[samp][i].mgtype[p] = samp_data[samp][i].mgtype[locusID];
-        }
-        numberOfAlleles[samp][p] = numberOfAlleles[samp][locusID];
-        for(i = 0; i < numberOfAlleles[samp][p]; i++) {
-          gType[samp][p][i] = gType[samp][locusID][i];
-          gcount[samp][p][i] = gcount[samp][locusID][i];
-        }
-        p++;
+      numberOfAlleles[samp][p] = numberOfAlleles[samp][locusID];
+      for(i = 0; i < numberOfAlleles[samp][p]; i++) {
+        gType[samp][p][i] = gType[samp][locusID][i];
+        gcount[samp][p][i] = gcount[samp][locusID][i];
       }
+      p++;
     }
+  }
 
-    // Accumulate counts in numberOfAlleles data structure and store in mnals
-    mnals[samp] = 0;
-    for(locusID = 0; locusID < parseNLoci(); locusID++){
-      mnals[samp] += numberOfAlleles[samp][locusID];
-    }
-    mnals[samp] /= parseNLoci();
+  // Accumulate counts in numberOfAlleles data structure and store in mnals
+  mnals[samp] = 0;
+  for(locusID = 0; locusID < numloci; locusID++){
+    mnals[samp] += numberOfAlleles[samp][locusID];
+  }
+  mnals[samp] /= numloci;
+}
+
+/*! \def counts(int ***numberOfAllelesPtr, struct gtype_type **samp_data, double mnals[], int ***gType, int ****gcountPtr)
+ *  \brief Generates genotype counts and mean number of allele data
+ */
+void counts(int ***numberOfAllelesPtr, struct gtype_type **samp_data, double mnals[], int ***gType, int ****gcountPtr)
+{
+  int samp;
+  // For each sample
+  for(samp = 0; samp < parseIterations(); samp++){
+    countsAssist(numberOfAllelesPtr, samp_data, mnals, gType, gcountPtr, samp);
   }
 }
 
@@ -499,46 +819,56 @@ void counts(int ***numberOfAllelesPtr, struct gtype_type **samp_data, double mna
 // STATISTIC 9: skew
 // STATISTIC 10: kurtosis
 
-/*! \def multih(int num_samples, struct gtype_type **samp_data, double mhomo[], double varhomo[], double skhomo[], double kurhomo[], int ***gType)
- *  \brief computes moments of homozygosity
+/*! \def multihAssist(int num_samples, struct gtype_type **samp_data, double mhomo[], double varhomo[], double skhomo[], double kurhomo[], int ***gType, int samp)
+ *  \brief computes moments of homozygosity of one sample
  */
-void multih(int num_samples, struct gtype_type **samp_data, double mhomo[], double varhomo[], double skhomo[], double kurhomo[], int ***gType)
+void multihAssist(int num_samples, struct gtype_type **samp_data, double mhomo[], double varhomo[], double skhomo[], double kurhomo[], int ***gType, int samp)
 {
-  int final_indivs_count = parseInputSamples();
-  int samp, ind, i, cnt;
+  int final_indivs_count = run_config.input_samples;
+  int numloci = run_config.num_loci;
+  int ind, i, cnt;
   int *data = (int *) malloc(final_indivs_count * sizeof(int));
   double s, ep, p, sdev;
-  for(samp = 0; samp < num_samples; samp++)  {
-    s = 0;
-    for(ind = 0; ind < final_indivs_count; ind++) {
-      cnt = 0;
-      for(i = 0; i < parseNLoci(); i++)  {
-        if(samp_data[samp][ind].mgtype[i] == samp_data[samp][ind].pgtype[i])  ++cnt;
-      }
-      data[ind] = cnt;
-      s += cnt;
+  s = 0;
+  for(ind = 0; ind < final_indivs_count; ind++) {
+    cnt = 0;
+    for(i = 0; i < numloci; i++)  {
+      if(samp_data[samp][ind].mgtype[i] == samp_data[samp][ind].pgtype[i])  ++cnt;
     }
+    data[ind] = cnt;
+    s += cnt;
+  }
 
-    // printf("%f%d\n", s, final_indivs_count);
-    mhomo[samp] = s/(double)final_indivs_count;
+  // printf("%f%d\n", s, final_indivs_count);
+  mhomo[samp] = s/(double)final_indivs_count;
 
-    sdev = ep = varhomo[samp] = skhomo[samp] = kurhomo[samp] = 0.0;
-    for(i = 0; i < final_indivs_count; i++) {
-      s = data[i] - mhomo[samp];
-      ep += s;
-      varhomo[samp] += (p = s*s);
-      skhomo[samp] += (p *= s);
-      kurhomo[samp] += (p *= s);
-    }
+  sdev = ep = varhomo[samp] = skhomo[samp] = kurhomo[samp] = 0.0;
+  for(i = 0; i < final_indivs_count; i++) {
+    s = data[i] - mhomo[samp];
+    ep += s;
+    varhomo[samp] += (p = s*s);
+    skhomo[samp] += (p *= s);
+    kurhomo[samp] += (p *= s);
+  }
 
-    varhomo[samp] = (varhomo[samp]-ep*ep/final_indivs_count)/(final_indivs_count-1);
-    sdev = sqrt(varhomo[samp]);
-    if (varhomo[samp]) {
-      skhomo[samp] /= (final_indivs_count*varhomo[samp]*sdev);
-      kurhomo[samp] /= (final_indivs_count*varhomo[samp]*varhomo[samp]);
-      kurhomo[samp] -= 3.0;
-    }
-  } // samp
+  varhomo[samp] = (varhomo[samp]-ep*ep/final_indivs_count)/(final_indivs_count-1);
+  sdev = sqrt(varhomo[samp]);
+  if (varhomo[samp]) {
+    skhomo[samp] /= (final_indivs_count*varhomo[samp]*sdev);
+    kurhomo[samp] /= (final_indivs_count*varhomo[samp]*varhomo[samp]);
+    kurhomo[samp] -= 3.0;
+  }
 
   free(data);
 }
+
+/*! \def multih(int num_samples, struct gtype_type **samp_data, double mhomo[], double varhomo[], double skhomo[], double kurhomo[], int ***gType)
+ *  \brief computes moments of homozygosity
+ */
+void multih(int num_samples, struct gtype_type **samp_data, double mhomo[], double varhomo[], double skhomo[], double kurhomo[], int ***gType)
+{
+  int samp;
+  for(samp = 0; samp < num_samples; samp++)  {
+    multihAssist(num_samples, samp_data, mhomo, varhomo, skhomo, kurhomo, gType, samp);
+  } // samp
+}
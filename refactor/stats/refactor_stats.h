@@ -5,15 +5,77 @@
 
 extern int ***gcount;
 
+/*! \def DRIFT_MAX_ALLELES
+ *  \brief Most distinct alleles tracked at a locus by driftAlleleCounts().
+ *  A mutation to a new allele when the list is full is not applied.
+ */
+#define DRIFT_MAX_ALLELES 64
+
+/*! \def FOUNDER_THETA_STEPS
+ *  \brief Steps of theta per factor of ten told apart by a founder table.
+ */
+#define FOUNDER_THETA_STEPS 1000
+
+/*! \brief Distribution of the mutant allele count of coalescent founders, set up for alias sampling.
+ *
+ * Column k holds count min_allele_count + k with probability threshold[k],
+ * and otherwise min_allele_count + alias[k]. The table depends on num_genes
+ * and min_allele_count, and on theta only when the mutant allele may be
+ * absent; it is kept while they stay the same. That theta is quantised to
+ * FOUNDER_THETA_STEPS steps per factor of ten.
+ */
+struct founder_table {
+  int num_genes;
+  int min_allele_count;
+  double theta;
+  int size;
+  int allocation;
+  double *threshold;
+  int *alias;
+};
+typedef struct founder_table founder_table;
+
+/*! \brief Returns the Burrows composite correlation of two alleles at two loci, as twolocusiisAssist() computes it.
+ *
+ * From cnt individuals counted, the copies of each allele (ofreq1, ofreq2),
+ * its homozygotes (psq1obs, psq2obs), and the sum over individuals of the
+ * product of their copies of both (doublesum). Returns NaN when the
+ * correlation is undefined.
+ */
+static inline double compositeCorrelation(int cnt, int ofreq1, int ofreq2, double psq1obs, double psq2obs, int doublesum)
+{
+  double dcnt = (double) cnt;
+  double p1 = ofreq1 / (2 * dcnt);
+  double p2 = ofreq2 / (2 * dcnt);
+  double jointAB = doublesum / (2 * dcnt);
+  // Departures from Hardy-Weinberg equilibrium
+  double d1 = psq1obs / dcnt - p1 * p1;
+  double d2 = psq2obs / dcnt - p2 * p2;
+  double sqrtFactor1 = sqrt(p1 * (1 - p1) + d1);
+  double sqrtFactor2 = sqrt(p2 * (1 - p2) + d2);
+  double r = (jointAB - 2 * p1 * p2) / sqrtFactor1 / sqrtFactor2;
+  // Correction for having a finite sample
+  return r * (dcnt / (dcnt - 1));
+}
+
 double fallingQuotient(double s, double t1, double t2, int c);
 double allelePr(int val1, int val2, double theta);
+double *coalescentFrequencies(int num_genes, int min_allele_count, double theta);
+void allocateFounderTable(struct founder_table *table);
+void deallocateFounderTable(struct founder_table *table);
+void prepareFounderTable(struct founder_table *table, int num_genes, int min_allele_count, double theta);
+int drawFounderCount(const struct founder_table *table);
 int minAlleleCount();
 
 void mutate(ALLELE_TYPE *gene, int motif);
 void mutateSNP(ALLELE_TYPE *gene);
 void mutateMicroSat(ALLELE_TYPE *gene, int motif);
+int driftAlleleCounts(ALLELE_TYPE *alleles, int *counts, int num_alleles, int num_genes, int generations, int samp, int motif);
 
+void blendAllelesScalar(ALLELE_TYPE *out, const ALLELE_TYPE *set, const ALLELE_TYPE *clear, unsigned int mask, int count);
+void blendAlleles(ALLELE_TYPE *out, const ALLELE_TYPE *set, const ALLELE_TYPE *clear, unsigned int mask, int count);
 void assort(int nextgen, gtype_type *offvec, gtype_type *mothers, gtype_type *fathers, int indivs, int samp, int num_loci);
+void assortLoci(int nextgen, gtype_type *offvec, gtype_type *mothers, gtype_type *fathers, const int *mother_index, const int *father_index, const int *offspring, int samp, int first_locus, int last_locus);
 void counts(int ***numberOfAllelesPtr, gtype_type **samp_data, double mnals[], int ***gType, int ****gcountPtr);
 void sortM(int **numberOfAlleles, int num_samples, double m[], int ***gType, int ****gcountPtr);
 void twolocusiis(int **numberOfAlleles,int num_samples, gtype_type **samp_data, double iis[], int ***gType, int ****gcountPtr);  // Weir composite LD estimator using all alleles
@@ -21,4 +83,12 @@ void beta(int **numberOfAlleles, int num_samples, double lnbeta[], int ***gType,
 void hetexcess(int **numberOfAlleles,int num_samples, gtype_type **samp_data, double hetx[], double mnehet[], int ***gType, int ****gcountPtr); // Need skiploc operational for missing data
 void multih(int num_samples, gtype_type **samp_data, double mhomo[], double varhomo[], double skhomo[], double kurhomo[], int ***gType);
 
+// Single-sample versions of the statistics, used when iterations run concurrently
+void countsAssist(int ***numberOfAllelesPtr, gtype_type **samp_data, double mnals[], int ***gType, int ****gcountPtr, int samp);
+void sortMAssist(int **numberOfAlleles, int num_samples, double m[], int ***gType, int ****gcountPtr, int samp);
+void twolocusiisAssist(int **numberOfAlleles, int num_samples, gtype_type **samp_data, double iis[], int ***gType, int ****gcountPtr, int samp);
+void betaAssist(int **numberOfAlleles, int num_samples, double lnbeta[], int ***gType, int ****gcountPtr, int samp);
+void hetexcessAssist(int **numberOfAlleles, int num_samples, gtype_type **samp_data, double hetx[], double mnehet[], int ***gType, int ****gcountPtr, int samp);
+void multihAssist(int num_samples, gtype_type **samp_data, double mhomo[], double varhomo[], double skhomo[], double kurhomo[], int ***gType, int samp);
+
 #endif
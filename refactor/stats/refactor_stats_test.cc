@@ -305,3 +305,136 @@ TEST(stats, SNPtest2){
   }
   free(final_indivs_data);
 }
+
+// onesamp -rPHILOX8 -t1 -b4 -d2 -u0 -v0.1 -s -l100 -i6 -o1 -p
+// Drift keeps the size of the gene pool, never creates alleles without
+// mutation, and eventually fixes one allele of a small pool.
+TEST(stats, drift_allele_counts){
+  char a0[] = "onesamp";
+  char a1[] = "-rPHILOX8";
+  char a2[] = "-t1";
+  char a3[] = "-b4";
+  char a4[] = "-d2";
+  char a5[] = "-u0";
+  char a6[] = "-v0.1";
+  char a7[] = "-s";
+  char a8[] = "-l100";
+  char a9[] = "-i6";
+  char a10[] = "-o1";
+  char a11[] = "-p";
+  char *argv[] = {a0, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11};
+  ALLELE_TYPE alleles[DRIFT_MAX_ALLELES] = {1, 3};
+  int counts[DRIFT_MAX_ALLELES] = {30, 70};
+  int num_alleles, generations;
+
+  parseArguments(12, argv);
+  useRandomStream(0, RANDOM_SUBSTREAM_SIMULATION);
+  EXPECT_EQ(driftAlleleCounts(alleles, counts, 2, 100, 0, 0, 0), 2);
+  EXPECT_EQ(counts[0], 30);
+  num_alleles = 2;
+  for(generations = 0; generations < 20; generations++){
+    num_alleles = driftAlleleCounts(alleles, counts, num_alleles, 100, 1, 0, 0);
+    EXPECT_GE(num_alleles, 1);
+    EXPECT_LE(num_alleles, 2);
+    EXPECT_EQ(num_alleles == 1 ? counts[0] : counts[0] + counts[1], 100);
+  }
+  num_alleles = driftAlleleCounts(alleles, counts, num_alleles, 100, 2000, 0, 0);
+  EXPECT_EQ(num_alleles, 1);
+  EXPECT_EQ(counts[0], 100);
+  EXPECT_TRUE(alleles[0] == 1 || alleles[0] == 3);
+  flushArguments();
+}
+
+// Returns the probability of column k of a founder table, added back up from
+// its own share and those aliased to it.
+static double founderMass(const struct founder_table *table, int k){
+  double mass = table->threshold[k];
+  int j;
+  for(j = 0; j < table->size; j++) if(j != k && table->alias[j] == k) mass += 1 - table->threshold[j];
+  return mass / table->size;
+}
+
+// onesamp -rPHILOX8 -t1 -b4 -d2 -u0 -v0.1 -s -l100 -i6 -o1 -p
+// The columns of a founder table add back up to coalescentFrequencies(), the
+// table is kept while the gene count stays, and draws stay in range. Without
+// a minimum count it also follows theta, one quantisation step at a time.
+TEST(stats, founder_table){
+  char a0[] = "onesamp";
+  char a1[] = "-rPHILOX8";
+  char a2[] = "-t1";
+  char a3[] = "-b4";
+  char a4[] = "-d2";
+  char a5[] = "-u0";
+  char a6[] = "-v0.1";
+  char a7[] = "-s";
+  char a8[] = "-l100";
+  char a9[] = "-i6";
+  char a10[] = "-o1";
+  char a11[] = "-p";
+  char *argv[] = {a0, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11};
+  const int num_genes = 400;
+  const int min_allele_count = 20;
+  struct founder_table table;
+  double *expected = coalescentFrequencies(num_genes, min_allele_count, 1.0);
+  double *threshold;
+  int j, count;
+
+  parseArguments(12, argv);
+  allocateFounderTable(&table);
+  prepareFounderTable(&table, num_genes, min_allele_count, 1.0);
+  EXPECT_EQ(table.size, num_genes / 2 - min_allele_count + 1);
+  {
+    double mass[table.size];
+    for(j = 0; j < table.size; j++) mass[j] = table.threshold[j];
+    for(j = 0; j < table.size; j++) if(table.alias[j] != j) mass[table.alias[j]] += 1 - table.threshold[j];
+    for(j = 0; j < table.size; j++) EXPECT_NEAR(mass[j] / table.size, expected[j], 1e-12);
+  }
+  threshold = table.threshold;
+  prepareFounderTable(&table, num_genes, min_allele_count, 5.0);
+  EXPECT_EQ(table.threshold, threshold);
+  {
+    double *low = coalescentFrequencies(num_genes, 0, 0.1);
+    double *high = coalescentFrequencies(num_genes, 0, 1.0);
+    prepareFounderTable(&table, num_genes, 0, 0.1 * (1 + 1e-6));
+    EXPECT_NEAR(founderMass(&table, 0), low[0], 1e-12);
+    prepareFounderTable(&table, num_genes, 0, 1.0);
+    EXPECT_NEAR(founderMass(&table, 0), high[0], 1e-12);
+    EXPECT_GT(low[0], high[0] + 1e-3);
+    free(low);
+    free(high);
+  }
+  prepareFounderTable(&table, num_genes, min_allele_count, 1.0);
+
+  useRandomStream(0, RANDOM_SUBSTREAM_SIMULATION);
+  for(j = 0; j < 1000; j++){
+    count = drawFounderCount(&table);
+    EXPECT_GE(count, min_allele_count);
+    EXPECT_LE(count, num_genes / 2);
+  }
+  deallocateFounderTable(&table);
+  free(expected);
+  flushArguments();
+}
+
+// The vector kernel picked at run time blends the same alleles as the scalar
+// one, for every length of a block of 32 loci.
+TEST(stats, blend_alleles){
+  const int count = 32;
+  ALLELE_TYPE set[count], clear[count], scalar[count], vector[count];
+  unsigned int masks[4] = {0x00000000U, 0xFFFFFFFFU, 0xA5C3F00FU, 0x12345678U};
+  int k, length, mask;
+
+  for(k = 0; k < count; k++){
+    set[k] = 100 + 2 * k;
+    clear[k] = 996 - 3 * k;
+  }
+  for(mask = 0; mask < 4; mask++){
+    for(length = 1; length <= count; length++){
+      for(k = 0; k < count; k++) scalar[k] = vector[k] = -1;
+      blendAllelesScalar(scalar, set, clear, masks[mask], length);
+      blendAlleles(vector, set, clear, masks[mask], length);
+      for(k = 0; k < count; k++) EXPECT_EQ(scalar[k], vector[k]);
+      for(k = 0; k < length; k++) EXPECT_EQ(scalar[k], (masks[mask] >> k) & 1 ? set[k] : clear[k]);
+    }
+  }
+}